@@ -0,0 +1,212 @@
+#pragma once
+#ifndef _BATCH_PTR_H
+#define _BATCH_PTR_H
+
+/**
+* BatchPtr
+* Creates many objects of the same type with a single allocation, and hands each of them out as its own pointer.
+*
+* InitRefPtrBatch makes one allocation that holds all count objects next to each other, each with its own control block,
+* and returns a RefPtr to every one of them. The handles are independent: each object is destroyed when its last
+* RefPtr goes away, and the allocation is freed when the last object in it has been destroyed.
+* InitScopedPtrBatch does the same for ScopedPtr, with a deleter that gives the object back to its batch.
+*
+* Every object is constructed from the same arguments, in order, so the handles point at consecutive slots
+* and walking them in order walks the memory in order.
+* Memory of destroyed objects is only given back with the whole batch, so a batch is best for objects that live and die together.
+*
+* Usage
+* Ptr::PtrVector<Ptr::RefPtr<Record>> records = Ptr::InitRefPtrBatch<Record>(1000);
+* Ptr::PtrVector<Ptr::ScopedPtr<Record, Ptr::BatchDeleter<Record>>> owned = Ptr::InitScopedPtrBatch<Record>(1000, parameters);
+*/
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#include "Ptr.h"
+#include "PtrVector.h"
+
+namespace Ptr
+{
+	namespace detail
+	{
+		//start of a batch, counts the objects in it that have not been destroyed yet
+		template <typename Counter>
+		struct BatchHeader
+		{
+			explicit BatchHeader(size_t count)
+				: live(count)
+			{
+			}
+
+			typename Counter::Type live;
+		};
+
+		//batch of count slots, laid out as the header followed by the slots
+		template <typename Slot, typename Counter>
+		struct Batch
+		{
+			using Header = BatchHeader<Counter>;
+
+			static constexpr size_t Alignment = alignof(Slot) > alignof(Header) ? alignof(Slot) : alignof(Header);
+			static constexpr size_t SlotOffset = (sizeof(Header) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+
+			//allocates the header and count slots, the slots are left for the caller to construct
+			//a live count with the immortal bit set would never reach zero, so such a batch is never handed out
+			static Header* Allocate(size_t count)
+			{
+				if (count >= size_t(Counter::ImmortalBit) || count > (size_t(-1) - SlotOffset) / sizeof(Slot))
+					throw std::bad_alloc();
+
+				void* memory = ::operator new(SlotOffset + count * sizeof(Slot), std::align_val_t(Alignment));
+				return new (memory) Header(count);
+			}
+
+			static Slot* Slots(Header* header)
+			{
+				return reinterpret_cast<Slot*>(reinterpret_cast<unsigned char*>(header) + SlotOffset);
+			}
+
+			//frees the batch once the last of its objects is gone
+			static void Release(Header* header, size_t count = 1)
+			{
+				if (Counter::Decrement(header->live, count) != 0)
+					return;
+
+				header->~Header();
+				::operator delete(header, std::align_val_t(Alignment));
+			}
+		};
+
+		//slot of a RefPtr batch, the control block and the object it controls
+		template <typename T, typename Counter>
+		struct RefBatchSlot : RefBlock<Counter>
+		{
+			explicit RefBatchSlot(BatchHeader<Counter>* header)
+				: RefBlock<Counter>(1, &Destroy), header(header)
+			{
+			}
+
+			T* Object() { return std::launder(reinterpret_cast<T*>(storage)); }
+
+			static void Destroy(RefBlock<Counter>* block)
+			{
+				RefBatchSlot* self = static_cast<RefBatchSlot*>(block);
+				BatchHeader<Counter>* header = self->header;
+
+				self->Object()->~T();
+				self->~RefBatchSlot();
+				Batch<RefBatchSlot, Counter>::Release(header);
+			}
+
+			BatchHeader<Counter>* header;
+			alignas(T) unsigned char storage[sizeof(T)];
+		};
+
+		//slot of a ScopedPtr batch, the objects can be destroyed from any thread so the header counts atomically
+		template <typename T>
+		struct ScopedBatchSlot
+		{
+			BatchHeader<AtomicRefCounter>* header;
+			alignas(T) unsigned char storage[sizeof(T)];
+		};
+
+		//allocates a batch and passes every slot to make, which constructs the slot and its object and keeps a handle to it
+		template <typename Slot, typename Counter, typename Make>
+		void FillBatch(size_t count, Make&& make)
+		{
+			BatchHeader<Counter>* header = Batch<Slot, Counter>::Allocate(count);
+			Slot* slots = Batch<Slot, Counter>::Slots(header);
+
+			size_t constructed = 0;
+			try
+			{
+				for (; constructed < count; constructed++)
+					make(header, slots + constructed);
+			}
+			catch (...)
+			{
+				//the handles made so far free their own objects, the slots that were never made are released here
+				if (constructed < count)
+					Batch<Slot, Counter>::Release(header, count - constructed);
+
+				throw;
+			}
+		}
+	}
+
+	//deleter of ScopedPtr from a batch, destroys the object and frees the batch when it was the last one
+	template <typename T>
+	struct BatchDeleter
+	{
+		void operator()(T* ptr) const
+		{
+			using Slot = detail::ScopedBatchSlot<T>;
+
+			Slot* slot = reinterpret_cast<Slot*>(reinterpret_cast<unsigned char*>(ptr) - offsetof(Slot, storage));
+			detail::BatchHeader<AtomicRefCounter>* header = slot->header;
+
+			ptr->~T();
+			detail::Batch<Slot, AtomicRefCounter>::Release(header);
+		}
+	};
+
+	//creates count objects in one allocation (PtrVector<RefPtr<T>> ptrs = InitRefPtrBatch<T>(count, parameters);)
+	//every object is constructed from the same parameters, each RefPtr can be copied and released on its own
+	//the parameters are passed as lvalues and never moved from, since every object uses them again
+	template <typename T, typename Counter = RefCounter, typename ... Args>
+	PtrVector<RefPtr<T, Counter>> InitRefPtrBatch(size_t count, Args&& ... mArgs)
+	{
+		static_assert(!detail::IsRefCounted<T>::value, "objects that derive from RefCounted are their own block, make them one at a time with InitRefPtr");
+
+		using Slot = detail::RefBatchSlot<T, Counter>;
+
+		PtrVector<RefPtr<T, Counter>> ptrs;
+		if (count == 0)
+			return ptrs;
+
+		//reserve before allocating, so nothing below can throw except a constructor
+		ptrs.Reserve(count);
+
+		detail::FillBatch<Slot, Counter>(count, [&](detail::BatchHeader<Counter>* header, Slot* slot)
+		{
+			//the block is trivial to destroy, if the constructor throws it is simply left behind
+			new (slot) Slot(header);
+			new (slot->storage) T(mArgs...);
+			ptrs.EmplaceBack(slot->Object(), slot);
+		});
+
+		return ptrs;
+	}
+
+	//creates count objects in one allocation, with pointers that can be shared between threads
+	template <typename T, typename ... Args>
+	PtrVector<AtomicRefPtr<T>> InitAtomicRefPtrBatch(size_t count, Args&& ... mArgs)
+	{
+		return InitRefPtrBatch<T, AtomicRefCounter>(count, mArgs...);
+	}
+
+	//creates count objects in one allocation (PtrVector<ScopedPtr<T, BatchDeleter<T>>> ptrs = InitScopedPtrBatch<T>(count, parameters);)
+	template <typename T, typename ... Args>
+	PtrVector<ScopedPtr<T, BatchDeleter<T>>> InitScopedPtrBatch(size_t count, Args&& ... mArgs)
+	{
+		using Slot = detail::ScopedBatchSlot<T>;
+
+		PtrVector<ScopedPtr<T, BatchDeleter<T>>> ptrs;
+		if (count == 0)
+			return ptrs;
+
+		ptrs.Reserve(count);
+
+		detail::FillBatch<Slot, AtomicRefCounter>(count, [&](detail::BatchHeader<AtomicRefCounter>* header, Slot* slot)
+		{
+			slot->header = header;
+			ptrs.EmplaceBack(new (slot->storage) T(mArgs...));
+		});
+
+		return ptrs;
+	}
+}
+
+#endif
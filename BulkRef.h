@@ -0,0 +1,123 @@
+#pragma once
+#ifndef _BULK_REF_H
+#define _BULK_REF_H
+
+/**
+* BulkRef
+* Reference counting for whole arrays of RefPtr at once, for snapshotting and releasing large shared arrays.
+*
+* Copying an array one RefPtr at a time loads and updates the count of every element as it gets to it,
+* and waits on each of those loads in turn.
+* These functions walk the array once: the blocks of elements a few places ahead are prefetched while the current one
+* is updated, adjacent elements that share a block are counted together with a single update,
+* and the objects whose count reaches 0 are collected and destroyed in groups after their counts are done.
+*
+* The arrays are given as a pointer and a count, so they work with std::vector, PtrVector and plain arrays alike.
+*
+* Usage
+* std::vector<Ptr::AtomicRefPtr<Node>> snapshot(nodes.size());
+* Ptr::CopyN(nodes.data(), nodes.size(), snapshot.data());
+* Ptr::DestroyN(snapshot.data(), snapshot.size()); //every pointer is left empty
+*/
+
+#include <cstddef>
+
+#include "Ptr.h"
+
+namespace Ptr
+{
+	namespace detail
+	{
+		//how many elements ahead the blocks are prefetched
+		constexpr size_t BulkPrefetchDistance = 8;
+		//how many objects are collected before they are destroyed
+		constexpr size_t BulkReleaseGroup = 32;
+
+		//returns the amount of elements from index on that share the block of ptrs[index]
+		template <typename T, typename Counter>
+		size_t SameBlockRun(const RefPtr<T, Counter>* ptrs, size_t index, size_t count)
+		{
+			RefBlock<Counter>* block = RefPtrAccess::GetBlock(ptrs[index]);
+
+			size_t run = 1;
+			while (index + run < count && RefPtrAccess::GetBlock(ptrs[index + run]) == block)
+				run++;
+
+			return run;
+		}
+	}
+
+	//adds a reference to every pointer, as if each of them was copied once
+	//for code that copies the bytes of the pointers itself, the copies own the new references
+	template <typename T, typename Counter>
+	void AddRefN(const RefPtr<T, Counter>* ptrs, size_t count)
+	{
+		size_t index = 0;
+		while (index < count)
+		{
+			if (index + detail::BulkPrefetchDistance < count)
+				PTR_PREFETCH(detail::RefPtrAccess::GetBlock(ptrs[index + detail::BulkPrefetchDistance]));
+
+			detail::RefBlock<Counter>* block = detail::RefPtrAccess::GetBlock(ptrs[index]);
+			size_t run = detail::SameBlockRun(ptrs, index, count);
+			index += run;
+
+			if (block != nullptr)
+				Counter::Increment(block->refs, run);
+		}
+	}
+
+	//releases every pointer and leaves them empty, like calling the destructor of each
+	template <typename T, typename Counter>
+	void DestroyN(RefPtr<T, Counter>* ptrs, size_t count)
+	{
+		detail::RefBlock<Counter>* released[detail::BulkReleaseGroup];
+		size_t releasedCount = 0;
+
+		size_t index = 0;
+		while (index < count)
+		{
+			if (index + detail::BulkPrefetchDistance < count)
+				PTR_PREFETCH(detail::RefPtrAccess::GetBlock(ptrs[index + detail::BulkPrefetchDistance]));
+
+			detail::RefBlock<Counter>* block = detail::RefPtrAccess::GetBlock(ptrs[index]);
+			size_t run = detail::SameBlockRun(ptrs, index, count);
+
+			//the references move out of the pointers and are given back below
+			for (size_t i = index; i < index + run; i++)
+				detail::RefPtrAccess::Detach(ptrs[i]);
+
+			index += run;
+
+			if (block == nullptr || Counter::Decrement(block->refs, run) != 0)
+				continue;
+
+			released[releasedCount++] = block;
+			if (releasedCount == detail::BulkReleaseGroup)
+			{
+				for (size_t i = 0; i < releasedCount; i++)
+					released[i]->destroy(released[i]);
+
+				releasedCount = 0;
+			}
+		}
+
+		for (size_t i = 0; i < releasedCount; i++)
+			released[i]->destroy(released[i]);
+	}
+
+	//makes every pointer in destination a copy of the pointer at the same index in source
+	//the old pointers in destination are released first, the two arrays can not overlap
+	template <typename T, typename Counter>
+	void CopyN(const RefPtr<T, Counter>* source, size_t count, RefPtr<T, Counter>* destination)
+	{
+		DestroyN(destination, count);
+		AddRefN(source, count);
+
+		//every destination is empty and the references were added above, so they are adopted as they are
+		for (size_t i = 0; i < count; i++)
+			destination[i] = RefPtr<T, Counter>(source[i].Get(), detail::RefPtrAccess::GetBlock(source[i]));
+	}
+}
+
+#endif
@@ -0,0 +1,464 @@
+#pragma once
+#ifndef _CACHING_ALLOCATOR_H
+#define _CACHING_ALLOCATOR_H
+
+/**
+* CachingAllocator
+* Size class allocator with a heap per thread, used for every object and control block Ptr allocates.
+*
+* Defining PTR_CACHING_ALLOCATOR before including Ptr.h makes InitScopedPtr, InitRefPtr and the control blocks of
+* RefPtr allocate from here instead of the global heap. DefaultDeleter and RefPtr check whether memory came from
+* here before giving it back, so pointers created with new still work the same way.
+* It has to be defined for every file of the program or for none of them, pass it on the compiler command line.
+*
+* Memory is split into 4MB segments that belong to one thread, and segments into 64KB pages that each hold blocks
+* of a single size class. A thread allocates and frees blocks of its own pages without any atomic operations.
+* A block freed by another thread is pushed onto a list of its page, frees to the same page are batched and
+* pushed with a single compare and swap, and the owning thread takes the whole list at once when it runs out.
+* When a thread exits, its segments are abandoned and adopted by the next thread that needs a new segment.
+* Segments are never given back to the system.
+*
+* Blocks are aligned to 16 bytes, requests bigger than MaxSize are not served and return nullptr.
+* Memory has to be given back with Deallocate (or DefaultDeleter for objects), a pointer released from a ScopedPtr
+* that was made by InitScopedPtr can not be passed to delete.
+*
+* Usage
+* //every file is compiled with -DPTR_CACHING_ALLOCATOR
+* #include "Ptr.h"
+* Ptr::RefPtr<Message> message = Ptr::InitRefPtr<Message>(parameters); //message and block come from this thread's heap
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+namespace Ptr
+{
+	//allocator with size classes and a cache of pages per thread
+	class CachingAllocator
+	{
+	public:
+		//biggest request that is served, and the alignment of every block
+		static constexpr size_t MaxSize = 8192;
+		static constexpr size_t Alignment = 16;
+
+		//returns a block of at least size bytes, or nullptr if size is bigger than MaxSize
+		static void* Allocate(size_t size);
+		//gives back a block returned by Allocate, from any thread
+		static void Deallocate(void* ptr);
+
+		//returns true if ptr points into memory that belongs to the allocator
+		static bool Owns(const void* ptr);
+
+	private:
+		static constexpr size_t SegmentShift = 22;
+		static constexpr size_t SegmentSize = size_t(1) << SegmentShift;
+		static constexpr size_t PageSize = 65536;
+		static constexpr size_t PageCount = SegmentSize / PageSize;
+		static constexpr size_t ClassCount = 32;
+		//amount of blocks freed for another thread that are held before they are pushed
+		static constexpr size_t RemoteBatch = 16;
+
+		//the map of segments covers 48 bit addresses, one byte per segment, in leaves of 8192 segments
+		static constexpr size_t MapShift = 13;
+		static constexpr size_t MapLeafSize = size_t(1) << MapShift;
+		static constexpr size_t MapSize = size_t(1) << (48 - SegmentShift - MapShift);
+
+		//free block, the link is kept in the memory of the block
+		struct Block
+		{
+			Block* next;
+		};
+
+		struct Heap;
+
+		//blocks of one size class
+		struct Page
+		{
+			//blocks freed by the thread that owns the page
+			Block* free = nullptr;
+			//blocks freed by other threads
+			std::atomic<Block*> remoteFree{ nullptr };
+			//part of the page that was never handed out
+			char* bump = nullptr;
+			char* end = nullptr;
+			size_t blockSize = 0;
+			size_t sizeClass = 0;
+			Page* next = nullptr;
+		};
+
+		//memory of one thread, the first page holds this header
+		struct Segment
+		{
+			std::atomic<Heap*> owner{ nullptr };
+			Segment* next = nullptr;
+			size_t usedPages = 1;
+			Page pages[PageCount];
+		};
+
+		//pages of one thread
+		struct Heap
+		{
+			~Heap();
+
+			//pages that may have free blocks, the first one is being allocated from
+			Page* pages[ClassCount] = {};
+			//pages that had no free blocks the last time they were looked at
+			Page* full[ClassCount] = {};
+			//segments of the thread, new pages come from the first one
+			Segment* segments = nullptr;
+
+			//blocks freed for a page of another thread, waiting to be pushed together
+			Page* remotePage = nullptr;
+			Block* remoteFirst = nullptr;
+			Block* remoteLast = nullptr;
+			size_t remoteCount = 0;
+		};
+
+		//segments of threads that have exited
+		struct Abandoned
+		{
+			std::mutex lock;
+			Segment* first = nullptr;
+		};
+
+		static_assert(sizeof(Segment) <= PageSize, "the segment header has to fit in the first page");
+
+		//functions to go from a size to its class and back
+		static size_t ClassOf(size_t size);
+		static size_t ClassSize(size_t sizeClass);
+
+		static Heap* LocalHeap();
+		static Abandoned& GetAbandoned();
+		static Segment* SegmentOf(const void* ptr);
+
+		//takes a block from a page, the page must have one
+		static void* Pop(Page& page);
+		//takes the blocks other threads freed, returns true if the page has a free block
+		static bool Collect(Page& page);
+
+		//finds a page with a free block, or makes a new one
+		static void* AllocateSlow(Heap& heap, size_t sizeClass);
+		static Page* NewPage(Heap& heap, size_t sizeClass);
+		//adopts an abandoned segment with free pages, or allocates a new one
+		static Segment* NewSegment(Heap& heap);
+
+		//pushes a chain of blocks onto the list of a page of another thread
+		static void PushRemote(Page& page, Block* first, Block* last);
+		//pushes the blocks the heap is holding for another thread
+		static void FlushRemote(Heap& heap);
+
+		//marks a segment in the map of segments
+		static void Mark(Segment* segment);
+
+	private:
+		inline static std::atomic<std::atomic<unsigned char>*> segmentMap[MapSize] = {};
+		//set once the heap of this thread is destroyed, the thread then stops allocating from here
+		inline static thread_local bool heapDestroyed = false;
+	};
+
+	inline void* CachingAllocator::Allocate(size_t size)
+	{
+		if (size > MaxSize || heapDestroyed)
+			return nullptr;
+
+		size_t sizeClass = ClassOf(size);
+		Heap& heap = *LocalHeap();
+
+		Page* page = heap.pages[sizeClass];
+		if (page != nullptr && (page->free != nullptr || page->bump != page->end))
+			return Pop(*page);
+
+		return AllocateSlow(heap, sizeClass);
+	}
+
+	inline void CachingAllocator::Deallocate(void* ptr)
+	{
+		Segment* segment = SegmentOf(ptr);
+		Page& page = segment->pages[(static_cast<char*>(ptr) - reinterpret_cast<char*>(segment)) / PageSize];
+		Block* block = static_cast<Block*>(ptr);
+
+		Heap* heap = heapDestroyed ? nullptr : LocalHeap();
+
+		//only the owner ever sets the owner to itself, so this can not change under us
+		if (heap != nullptr && segment->owner.load(std::memory_order_relaxed) == heap)
+		{
+			block->next = page.free;
+			page.free = block;
+			return;
+		}
+
+		if (heap == nullptr)
+		{
+			PushRemote(page, block, block);
+			return;
+		}
+
+		//frees to the same page of another thread are chained up and pushed together
+		if (heap->remotePage != &page)
+		{
+			FlushRemote(*heap);
+			heap->remotePage = &page;
+			heap->remoteLast = block;
+		}
+
+		block->next = heap->remoteFirst;
+		heap->remoteFirst = block;
+		heap->remoteCount++;
+
+		if (heap->remoteCount >= RemoteBatch)
+			FlushRemote(*heap);
+	}
+
+	inline bool CachingAllocator::Owns(const void* ptr)
+	{
+		size_t index = static_cast<size_t>(reinterpret_cast<uintptr_t>(ptr) >> SegmentShift);
+		if (index >= MapSize * MapLeafSize)
+			return false;
+
+		std::atomic<unsigned char>* leaf = segmentMap[index >> MapShift].load(std::memory_order_acquire);
+		return leaf != nullptr && leaf[index & (MapLeafSize - 1)].load(std::memory_order_relaxed) != 0;
+	}
+
+	inline CachingAllocator::Heap::~Heap()
+	{
+		FlushRemote(*this);
+
+		//the thread is exiting, its segments go to whoever needs one next
+		//blocks freed into them from now on go through the remote lists
+		Abandoned& abandoned = GetAbandoned();
+		std::lock_guard<std::mutex> guard(abandoned.lock);
+
+		while (segments != nullptr)
+		{
+			Segment* segment = segments;
+			segments = segment->next;
+
+			segment->owner.store(nullptr, std::memory_order_relaxed);
+			segment->next = abandoned.first;
+			abandoned.first = segment;
+		}
+
+		heapDestroyed = true;
+	}
+
+	inline size_t CachingAllocator::ClassOf(size_t size)
+	{
+		//16 byte steps up to 128, then 4 classes for every power of 2
+		if (size <= 128)
+			return size > 0 ? (size - 1) >> 4 : 0;
+
+		size_t shift = 0;
+		for (size_t rest = (size - 1) >> 1; rest != 0; rest >>= 1)
+			shift++;
+
+		return 8 + (shift - 7) * 4 + (((size - 1) >> (shift - 2)) & 3);
+	}
+
+	inline size_t CachingAllocator::ClassSize(size_t sizeClass)
+	{
+		if (sizeClass < 8)
+			return (sizeClass + 1) * 16;
+
+		size_t shift = 7 + (sizeClass - 8) / 4;
+		return (size_t(1) << shift) + ((sizeClass - 8) % 4 + 1) * (size_t(1) << (shift - 2));
+	}
+
+	inline CachingAllocator::Heap* CachingAllocator::LocalHeap()
+	{
+		static thread_local Heap heap;
+		return &heap;
+	}
+
+	inline CachingAllocator::Abandoned& CachingAllocator::GetAbandoned()
+	{
+		//never destroyed, threads can still exit while static objects are being destroyed
+		static Abandoned* abandoned = new Abandoned();
+		return *abandoned;
+	}
+
+	inline CachingAllocator::Segment* CachingAllocator::SegmentOf(const void* ptr)
+	{
+		return reinterpret_cast<Segment*>(reinterpret_cast<uintptr_t>(ptr) & ~static_cast<uintptr_t>(SegmentSize - 1));
+	}
+
+	inline void* CachingAllocator::Pop(Page& page)
+	{
+		if (page.free != nullptr)
+		{
+			Block* block = page.free;
+			page.free = block->next;
+			return block;
+		}
+
+		void* block = page.bump;
+		page.bump += page.blockSize;
+		return block;
+	}
+
+	inline bool CachingAllocator::Collect(Page& page)
+	{
+		if (page.free != nullptr || page.bump != page.end)
+			return true;
+
+		//take every block other threads freed in one go, nobody else takes from this list so there is no ABA
+		page.free = page.remoteFree.exchange(nullptr, std::memory_order_acquire);
+		return page.free != nullptr;
+	}
+
+	inline void* CachingAllocator::AllocateSlow(Heap& heap, size_t sizeClass)
+	{
+		//blocks held for other threads may be what they are waiting on
+		FlushRemote(heap);
+
+		//look for a page with a free block, moving the full ones out of the way
+		while (heap.pages[sizeClass] != nullptr)
+		{
+			Page* page = heap.pages[sizeClass];
+			if (Collect(*page))
+				return Pop(*page);
+
+			heap.pages[sizeClass] = page->next;
+			page->next = heap.full[sizeClass];
+			heap.full[sizeClass] = page;
+		}
+
+		//other threads may have freed blocks of the full pages since they were moved
+		for (Page** link = &heap.full[sizeClass]; *link != nullptr; link = &(*link)->next)
+		{
+			Page* page = *link;
+			if (Collect(*page))
+			{
+				*link = page->next;
+				page->next = nullptr;
+				heap.pages[sizeClass] = page;
+				return Pop(*page);
+			}
+		}
+
+		Page* page = NewPage(heap, sizeClass);
+		if (page == nullptr)
+			return nullptr;
+
+		heap.pages[sizeClass] = page;
+		return Pop(*page);
+	}
+
+	inline CachingAllocator::Page* CachingAllocator::NewPage(Heap& heap, size_t sizeClass)
+	{
+		Segment* segment = heap.segments;
+		if (segment == nullptr || segment->usedPages == PageCount)
+		{
+			segment = NewSegment(heap);
+			if (segment == nullptr)
+				return nullptr;
+		}
+
+		size_t index = segment->usedPages++;
+		Page* page = &segment->pages[index];
+		char* start = reinterpret_cast<char*>(segment) + index * PageSize;
+
+		page->blockSize = ClassSize(sizeClass);
+		page->sizeClass = sizeClass;
+		page->bump = start;
+		page->end = start + (PageSize / page->blockSize) * page->blockSize;
+		page->next = nullptr;
+		return page;
+	}
+
+	inline CachingAllocator::Segment* CachingAllocator::NewSegment(Heap& heap)
+	{
+		Abandoned& abandoned = GetAbandoned();
+
+		while (true)
+		{
+			Segment* segment;
+			{
+				std::lock_guard<std::mutex> guard(abandoned.lock);
+				segment = abandoned.first;
+				if (segment == nullptr)
+					break;
+
+				abandoned.first = segment->next;
+			}
+
+			//adopt the segment, its pages are put back in the lists and sorted out when they are allocated from
+			segment->owner.store(&heap, std::memory_order_relaxed);
+			for (size_t i = 1; i < segment->usedPages; i++)
+			{
+				Page& page = segment->pages[i];
+				page.next = heap.pages[page.sizeClass];
+				heap.pages[page.sizeClass] = &page;
+			}
+
+			segment->next = heap.segments;
+			heap.segments = segment;
+
+			if (segment->usedPages < PageCount)
+				return segment;
+		}
+
+		void* memory = ::operator new(SegmentSize, std::align_val_t(SegmentSize), std::nothrow);
+		if (memory == nullptr)
+			return nullptr;
+
+		//memory past what the map covers can not be told apart from the global heap
+		if ((reinterpret_cast<uintptr_t>(memory) >> SegmentShift) >= MapSize * MapLeafSize)
+		{
+			::operator delete(memory, std::align_val_t(SegmentSize));
+			return nullptr;
+		}
+
+		Segment* segment = new (memory) Segment();
+		segment->owner.store(&heap, std::memory_order_relaxed);
+		segment->next = heap.segments;
+		heap.segments = segment;
+
+		Mark(segment);
+		return segment;
+	}
+
+	inline void CachingAllocator::PushRemote(Page& page, Block* first, Block* last)
+	{
+		Block* head = page.remoteFree.load(std::memory_order_relaxed);
+		do
+		{
+			last->next = head;
+		} while (!page.remoteFree.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	inline void CachingAllocator::FlushRemote(Heap& heap)
+	{
+		if (heap.remotePage == nullptr)
+			return;
+
+		PushRemote(*heap.remotePage, heap.remoteFirst, heap.remoteLast);
+
+		heap.remotePage = nullptr;
+		heap.remoteFirst = nullptr;
+		heap.remoteLast = nullptr;
+		heap.remoteCount = 0;
+	}
+
+	inline void CachingAllocator::Mark(Segment* segment)
+	{
+		size_t index = static_cast<size_t>(reinterpret_cast<uintptr_t>(segment) >> SegmentShift);
+		std::atomic<std::atomic<unsigned char>*>& slot = segmentMap[index >> MapShift];
+
+		std::atomic<unsigned char>* leaf = slot.load(std::memory_order_acquire);
+		if (leaf == nullptr)
+		{
+			std::atomic<unsigned char>* created = new std::atomic<unsigned char>[MapLeafSize]();
+			if (slot.compare_exchange_strong(leaf, created, std::memory_order_acq_rel))
+				leaf = created;
+			else
+				delete[] created;
+		}
+
+		leaf[index & (MapLeafSize - 1)].store(1, std::memory_order_relaxed);
+	}
+}
+
+#endif
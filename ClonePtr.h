@@ -0,0 +1,221 @@
+#pragma once
+#ifndef _CLONE_PTR_H
+#define _CLONE_PTR_H
+
+/**
+* ClonePtr
+* Owning pointer to a polymorphic object that deep copies the object when the pointer is copied.
+*
+* The factory that creates the object remembers how to copy its concrete type, so copying a ClonePtr<Base>
+* copies the whole derived object without a virtual Clone() function on Base.
+* A ClonePtr<Base> is two pointers wide. ClonePtr<Base, N> also keeps objects of up to N bytes inline,
+* the same way InlinePtr does.
+*
+* Usage
+* Ptr::ClonePtr<Shape> shape = Ptr::InitClonePtr<Shape, Circle>(parameters);
+* Ptr::ClonePtr<Shape> copy = shape; //copy holds a new Circle
+*/
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "InlinePtr.h"
+
+namespace Ptr
+{
+	//pointer that owns a polymorphic object and copies it along with the pointer
+	template <typename Base, size_t N = 0>
+	class ClonePtr : private detail::InlineBuffer<N>
+	{
+	public:
+		//default constructor
+		ClonePtr();
+
+		//copy constructor and copy assignment operator, these copy the object as its concrete type
+		ClonePtr(const ClonePtr& other);
+		ClonePtr& operator=(const ClonePtr& other);
+
+		//rvalue constructor and move assignment operator
+		ClonePtr(ClonePtr&& other) noexcept;
+		ClonePtr& operator=(ClonePtr&& other) noexcept;
+
+		//destructor
+		~ClonePtr();
+
+		//destroys the current object and constructs a new one (ptr.Emplace<Derived>(parameters);)
+		template <typename Derived = Base, typename ... Args>
+		Derived* Emplace(Args&& ... mArgs);
+
+		//functions that return the raw pointer
+		Base* Get() const;
+		Base* operator->() const;
+
+		//functions that dereferences pointer
+		Base& Dereference() const;
+		Base& operator*() const;
+
+		//returns true if the object is stored inside of the pointer
+		bool IsInline() const;
+
+	private:
+		using Buffer = detail::InlineBuffer<N>;
+
+		//takes the object out of other
+		void Steal(ClonePtr& other);
+
+		//function for cleanup
+		void Clean();
+
+	private:
+		Base* ptr;
+		const detail::PolyOps<Base>* ops;
+	};
+
+	//calls constructor for an object (ClonePtr<Base> ptr = InitClonePtr<Base, Derived>(parameters);)
+	template <typename Base, typename Derived = Base, size_t N = 0, typename ... Args>
+	ClonePtr<Base, N> InitClonePtr(Args&& ... mArgs)
+	{
+		ClonePtr<Base, N> ptr;
+		ptr.template Emplace<Derived>(std::forward<Args>(mArgs)...);
+		return ptr;
+	}
+
+	template <typename Base, size_t N>
+	ClonePtr<Base, N>::ClonePtr()
+		: ptr(nullptr), ops(nullptr)
+	{
+	}
+
+	template <typename Base, size_t N>
+	ClonePtr<Base, N>::ClonePtr(const ClonePtr& other)
+		: ptr(nullptr), ops(other.ops)
+	{
+		//an inline object is copied into our buffer, anything else onto the heap
+		if (other.ptr != nullptr)
+			ptr = ops->copy(other.ptr, other.IsInline() ? Buffer::Storage() : nullptr);
+	}
+
+	template <typename Base, size_t N>
+	ClonePtr<Base, N>& ClonePtr<Base, N>::operator=(const ClonePtr& other)
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			//copy first, so we are left untouched if the copy throws
+			ClonePtr copy(other);
+
+			Clean();
+			Steal(copy);
+		}
+
+		return *this;
+	}
+
+	template <typename Base, size_t N>
+	ClonePtr<Base, N>::ClonePtr(ClonePtr&& other) noexcept
+		: ptr(nullptr), ops(nullptr)
+	{
+		Steal(other);
+	}
+
+	template <typename Base, size_t N>
+	ClonePtr<Base, N>& ClonePtr<Base, N>::operator=(ClonePtr&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+			Steal(other);
+		}
+
+		return *this;
+	}
+
+	template <typename Base, size_t N>
+	ClonePtr<Base, N>::~ClonePtr()
+	{
+		Clean();
+	}
+
+	template <typename Base, size_t N>
+	template <typename Derived, typename ... Args>
+	Derived* ClonePtr<Base, N>::Emplace(Args&& ... mArgs)
+	{
+		static_assert(std::is_base_of<Base, Derived>::value || std::is_same<Base, Derived>::value, "Derived must derive from Base");
+		static_assert(std::is_copy_constructible<Derived>::value, "ClonePtr needs a copy constructor");
+
+		Clean();
+
+		Derived* object;
+		if constexpr (detail::FitsInline<Derived, N>::value)
+			object = new (Buffer::Storage()) Derived(std::forward<Args>(mArgs)...);
+		else
+			object = new Derived(std::forward<Args>(mArgs)...);
+
+		ptr = object;
+		ops = detail::GetPolyOps<Base, Derived, detail::FitsInline<Derived, N>::value>();
+		return object;
+	}
+
+	template <typename Base, size_t N>
+	Base* ClonePtr<Base, N>::Get() const
+	{
+		return ptr;
+	}
+
+	template <typename Base, size_t N>
+	Base* ClonePtr<Base, N>::operator->() const
+	{
+		return ptr;
+	}
+
+	template <typename Base, size_t N>
+	Base& ClonePtr<Base, N>::Dereference() const
+	{
+		return *ptr;
+	}
+
+	template <typename Base, size_t N>
+	Base& ClonePtr<Base, N>::operator*() const
+	{
+		return *ptr;
+	}
+
+	template <typename Base, size_t N>
+	bool ClonePtr<Base, N>::IsInline() const
+	{
+		return Buffer::Holds(ptr);
+	}
+
+	template <typename Base, size_t N>
+	void ClonePtr<Base, N>::Steal(ClonePtr& other)
+	{
+		if (other.ptr == nullptr)
+			return;
+
+		//heap objects just change owner, inline objects have to be moved into our buffer
+		if (other.IsInline())
+			ptr = other.ops->relocate(other.ptr, Buffer::Storage());
+		else
+			ptr = other.ptr;
+
+		ops = other.ops;
+
+		other.ptr = nullptr;
+		other.ops = nullptr;
+	}
+
+	template <typename Base, size_t N>
+	void ClonePtr<Base, N>::Clean()
+	{
+		//if the pointer is not pointing to nothing, destroy the object
+		if (ptr != nullptr)
+			ops->destroy(ptr, IsInline());
+
+		ptr = nullptr;
+		ops = nullptr;
+	}
+}
+
+#endif
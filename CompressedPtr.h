@@ -0,0 +1,649 @@
+#pragma once
+#ifndef _COMPRESSED_PTR_H
+#define _COMPRESSED_PTR_H
+
+/**
+* CompressedPtr
+* 32 bit pointers relative to the base of an arena.
+*
+* Every allocation in an arena is aligned to (1 << Shift) bytes, so a pointer can be stored as a 32 bit offset
+* counted in granules instead of a full 64 bit address. With the default shift of 3 an arena can address
+* up to 32 GiB of 8 byte aligned objects. Decoding is a single shift and add off the arena base.
+*
+* There is one arena per tag type, the base is a static so the pointer itself never stores it.
+* An offset of 0 is reserved for nullptr, the first granule of every arena is never handed out.
+*
+* Usage
+* struct GraphArena {};
+* Ptr::CompressedArena<GraphArena>::Init(size_t(1) << 30);
+* Ptr::CompressedRefPtr<Node, GraphArena> node = Ptr::InitCompressedRefPtr<Node, GraphArena>(parameters);
+*/
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace Ptr
+{
+	//default tag for compressed arenas, declare your own tag type to get a separate arena (struct GraphArena {};)
+	struct DefaultArena {};
+
+	//contiguous region of memory that compressed pointers are relative to
+	//freed blocks are kept in exact size free lists and reused before the arena grows
+	template <typename Tag = DefaultArena, unsigned Shift = 3>
+	class CompressedArena
+	{
+	public:
+		static_assert(Shift >= 2, "granules must be able to hold a 32 bit free list link");
+
+		//size and alignment of every allocation
+		static constexpr size_t Granule = size_t(1) << Shift;
+		//largest capacity a 32 bit offset can address
+		static constexpr uint64_t MaxCapacity = uint64_t(UINT32_MAX) << Shift;
+		//blocks up to this many granules get a free list of their own, bigger ones share one list
+		static constexpr uint32_t ListedGranules = 256;
+
+		//reserves the arena (CompressedArena<Tag>::Init(size_t(1) << 30);)
+		//the memory is only committed by the os as it is touched, so reserving a large arena is cheap
+		//does nothing if the arena is already initialized
+		static void Init(size_t capacity);
+		//frees the whole arena, every pointer into it becomes invalid
+		static void Release();
+
+		//allocates size bytes rounded up to a granule, throws std::bad_alloc once the arena is full or size can not fit in it
+		static void* Allocate(size_t size);
+		//returns a block to the arena, size must be the size it was allocated with
+		static void Deallocate(void* ptr, size_t size);
+
+		//converts between addresses and offsets
+		static uint32_t Encode(const void* ptr);
+		static void* Decode(uint32_t offset);
+
+		//returns the start of the arena
+		static char* Base();
+
+	private:
+		//returns the amount of granules needed to hold size bytes, throws std::bad_alloc if that does not fit in 32 bits
+		static uint32_t Granules(size_t size);
+
+	private:
+		static inline char* base = nullptr;
+		static inline uint64_t capacity = 0;
+		//offset of the first granule that has never been allocated
+		static inline uint32_t top = 0;
+		//head offset of the free list for each block size, indexed by granule count
+		//fixed in size so that Deallocate never has to allocate
+		static inline std::array<uint32_t, ListedGranules + 1> freeLists = {};
+		//head offset of the list of bigger free blocks, each one keeps its granule count after its link
+		static inline uint32_t largeList = 0;
+		static inline std::mutex lock;
+	};
+
+	//non owning 32 bit pointer into an arena
+	template <typename T, typename Tag = DefaultArena, unsigned Shift = 3>
+	class CompressedPtr
+	{
+	public:
+		using Arena = CompressedArena<Tag, Shift>;
+
+		//default constructor
+		CompressedPtr();
+		//constructor that takes in a pointer to an object that lives in the arena
+		CompressedPtr(T* ptr);
+
+		//functions that return the raw pointer
+		T* Get() const;
+		T* operator->() const;
+
+		//functions that dereferences pointer
+		T& Dereference() const;
+		T& operator*() const;
+
+		//returns the stored offset
+		uint32_t GetOffset() const;
+
+	private:
+		uint32_t offset;
+	};
+
+	//owning 32 bit pointer, the arena counterpart of ScopedPtr
+	template <typename T, typename Tag = DefaultArena, unsigned Shift = 3>
+	class CompressedScopedPtr
+	{
+	public:
+		using Arena = CompressedArena<Tag, Shift>;
+
+		//default constructor
+		CompressedScopedPtr();
+		//constructor that takes in a pointer that was allocated from the arena (use InitCompressedScopedPtr)
+		explicit CompressedScopedPtr(T* ptr);
+
+		//deleted functions to avoid copying of pointers (use CompressedRefPtr)
+		CompressedScopedPtr(const CompressedScopedPtr&) = delete;
+		CompressedScopedPtr& operator=(const CompressedScopedPtr&) = delete;
+
+		//rvalue constructor and move assignment operator
+		CompressedScopedPtr(CompressedScopedPtr&& other) noexcept;
+		CompressedScopedPtr& operator=(CompressedScopedPtr&& other) noexcept;
+
+		//destructor
+		~CompressedScopedPtr();
+
+		//functions that return the raw pointer
+		T* Get() const;
+		T* operator->() const;
+
+		//functions that dereferences pointer
+		T& Dereference() const;
+		T& operator*() const;
+
+		//returns a non owning pointer to the same object
+		CompressedPtr<T, Tag, Shift> GetCompressed() const;
+
+	private:
+		//function for cleanup
+		void Clean();
+
+	private:
+		uint32_t offset;
+	};
+
+	namespace detail
+	{
+		//the object and the count of a CompressedRefPtr share one arena block
+		//the object comes first so it starts on a granule, and the offset of the block is the offset of the object
+		template <typename T>
+		struct CompressedRefBlock
+		{
+			alignas(T) unsigned char storage[sizeof(T)];
+			uint32_t refs;
+
+			T* Object() { return std::launder(reinterpret_cast<T*>(storage)); }
+		};
+	}
+
+	//reference counted 32 bit pointer, the arena counterpart of RefPtr
+	//the count lives right after the object, so the pointer is a single offset
+	template <typename T, typename Tag = DefaultArena, unsigned Shift = 3>
+	class CompressedRefPtr
+	{
+	public:
+		using Arena = CompressedArena<Tag, Shift>;
+
+		//default constructor
+		CompressedRefPtr();
+
+		//copy constructor and copy assignment operator
+		CompressedRefPtr(const CompressedRefPtr& other);
+		CompressedRefPtr& operator=(const CompressedRefPtr& other);
+
+		//rvalue constructor and move assignment operator
+		CompressedRefPtr(CompressedRefPtr&& other) noexcept;
+		CompressedRefPtr& operator=(CompressedRefPtr&& other) noexcept;
+
+		//destructor
+		~CompressedRefPtr();
+
+		//functions that return the raw pointer
+		T* Get() const;
+		T* operator->() const;
+
+		//functions that dereferences pointer
+		T& Dereference() const;
+		T& operator*() const;
+
+		//returns the amount of pointers to a memory address
+		size_t GetRefCount() const;
+
+		//returns a non owning pointer to the same object
+		CompressedPtr<T, Tag, Shift> GetCompressed() const;
+
+	private:
+		using Block = detail::CompressedRefBlock<T>;
+
+		template <typename U, typename UTag, unsigned UShift, typename ... Args>
+		friend CompressedRefPtr<U, UTag, UShift> InitCompressedRefPtr(Args&& ... mArgs);
+
+		//takes ownership of a block that already has a count of 1
+		explicit CompressedRefPtr(Block* block);
+
+		Block* GetBlock() const;
+
+		//function for cleanup
+		void Clean();
+
+	private:
+		uint32_t offset;
+	};
+
+	//calls constructor for an object inside of an arena (CompressedScopedPtr<T> ptr = InitCompressedScopedPtr<T>(parameters);)
+	template <typename T, typename Tag = DefaultArena, unsigned Shift = 3, typename ... Args>
+	CompressedScopedPtr<T, Tag, Shift> InitCompressedScopedPtr(Args&& ... mArgs)
+	{
+		static_assert(alignof(T) <= CompressedArena<Tag, Shift>::Granule, "type is over aligned for this arena");
+
+		void* memory = CompressedArena<Tag, Shift>::Allocate(sizeof(T));
+		try
+		{
+			return CompressedScopedPtr<T, Tag, Shift>(new (memory) T(std::forward<Args>(mArgs)...));
+		}
+		catch (...)
+		{
+			CompressedArena<Tag, Shift>::Deallocate(memory, sizeof(T));
+			throw;
+		}
+	}
+
+	//calls constructor for an object inside of an arena (CompressedRefPtr<T> ptr = InitCompressedRefPtr<T>(parameters);)
+	//the object and its count are allocated together
+	template <typename T, typename Tag = DefaultArena, unsigned Shift = 3, typename ... Args>
+	CompressedRefPtr<T, Tag, Shift> InitCompressedRefPtr(Args&& ... mArgs)
+	{
+		using Block = detail::CompressedRefBlock<T>;
+		static_assert(alignof(Block) <= CompressedArena<Tag, Shift>::Granule, "type is over aligned for this arena");
+
+		Block* block = static_cast<Block*>(CompressedArena<Tag, Shift>::Allocate(sizeof(Block)));
+		try
+		{
+			new (block->storage) T(std::forward<Args>(mArgs)...);
+		}
+		catch (...)
+		{
+			CompressedArena<Tag, Shift>::Deallocate(block, sizeof(Block));
+			throw;
+		}
+
+		block->refs = 1;
+		return CompressedRefPtr<T, Tag, Shift>(block);
+	}
+
+	template <typename Tag, unsigned Shift>
+	void CompressedArena<Tag, Shift>::Init(size_t size)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		if (base != nullptr)
+			return;
+
+		//round the capacity to whole granules, and clamp it to what an offset can reach
+		capacity = (uint64_t(size) + Granule - 1) & ~uint64_t(Granule - 1);
+		if (capacity > MaxCapacity)
+			capacity = MaxCapacity;
+
+		base = static_cast<char*>(::operator new(size_t(capacity), std::align_val_t(Granule)));
+
+		//skip the first granule so that an offset of 0 can mean nullptr
+		top = 1;
+		freeLists.fill(0);
+		largeList = 0;
+	}
+
+	template <typename Tag, unsigned Shift>
+	void CompressedArena<Tag, Shift>::Release()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		if (base == nullptr)
+			return;
+
+		::operator delete(base, std::align_val_t(Granule));
+		base = nullptr;
+		capacity = 0;
+		top = 0;
+		freeLists.fill(0);
+		largeList = 0;
+	}
+
+	template <typename Tag, unsigned Shift>
+	void* CompressedArena<Tag, Shift>::Allocate(size_t size)
+	{
+		uint32_t granules = Granules(size);
+
+		std::lock_guard<std::mutex> guard(lock);
+
+		//reuse a freed block of the same size if there is one
+		if (granules <= ListedGranules && freeLists[granules] != 0)
+		{
+			uint32_t offset = freeLists[granules];
+			freeLists[granules] = *reinterpret_cast<uint32_t*>(base + (uint64_t(offset) << Shift));
+			return base + (uint64_t(offset) << Shift);
+		}
+
+		//bigger blocks are rare, so their list is searched for one of the exact size
+		if (granules > ListedGranules)
+		{
+			for (uint32_t* link = &largeList; *link != 0; link = reinterpret_cast<uint32_t*>(base + (uint64_t(*link) << Shift)))
+			{
+				uint32_t* block = reinterpret_cast<uint32_t*>(base + (uint64_t(*link) << Shift));
+				if (block[1] == granules)
+				{
+					*link = block[0];
+					return block;
+				}
+			}
+		}
+
+		//otherwise bump the top of the arena
+		if (base == nullptr || (uint64_t(top) + granules) << Shift > capacity)
+			throw std::bad_alloc();
+
+		uint32_t offset = top;
+		top += granules;
+		return base + (uint64_t(offset) << Shift);
+	}
+
+	template <typename Tag, unsigned Shift>
+	void CompressedArena<Tag, Shift>::Deallocate(void* ptr, size_t size)
+	{
+		if (ptr == nullptr)
+			return;
+
+		uint32_t granules = Granules(size);
+		uint32_t offset = Encode(ptr);
+
+		std::lock_guard<std::mutex> guard(lock);
+
+		//push the block on the front of its free list, the link is stored in the block itself
+		uint32_t* block = static_cast<uint32_t*>(ptr);
+		if (granules <= ListedGranules)
+		{
+			block[0] = freeLists[granules];
+			freeLists[granules] = offset;
+		}
+		else
+		{
+			block[0] = largeList;
+			block[1] = granules;
+			largeList = offset;
+		}
+	}
+
+	template <typename Tag, unsigned Shift>
+	uint32_t CompressedArena<Tag, Shift>::Encode(const void* ptr)
+	{
+		if (ptr == nullptr)
+			return 0;
+
+		return uint32_t(uint64_t(static_cast<const char*>(ptr) - base) >> Shift);
+	}
+
+	template <typename Tag, unsigned Shift>
+	void* CompressedArena<Tag, Shift>::Decode(uint32_t offset)
+	{
+		//a select rather than a branch, the compiler turns this into a conditional move
+		return offset != 0 ? base + (uint64_t(offset) << Shift) : nullptr;
+	}
+
+	template <typename Tag, unsigned Shift>
+	char* CompressedArena<Tag, Shift>::Base()
+	{
+		return base;
+	}
+
+	template <typename Tag, unsigned Shift>
+	uint32_t CompressedArena<Tag, Shift>::Granules(size_t size)
+	{
+		if (size == 0)
+			size = 1;
+
+		//checked before rounding up, so the addition below can not wrap either
+		if (size > MaxCapacity)
+			throw std::bad_alloc();
+
+		return uint32_t((uint64_t(size) + Granule - 1) >> Shift);
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedPtr<T, Tag, Shift>::CompressedPtr()
+		: offset(0)
+	{
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedPtr<T, Tag, Shift>::CompressedPtr(T* ptr)
+		: offset(Arena::Encode(ptr))
+	{
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T* CompressedPtr<T, Tag, Shift>::Get() const
+	{
+		return static_cast<T*>(Arena::Decode(offset));
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T* CompressedPtr<T, Tag, Shift>::operator->() const
+	{
+		//dereferencing a null pointer is invalid anyway, so skip the null check and just shift and add
+		return reinterpret_cast<T*>(Arena::Base() + (uint64_t(offset) << Shift));
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T& CompressedPtr<T, Tag, Shift>::Dereference() const
+	{
+		return *operator->();
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T& CompressedPtr<T, Tag, Shift>::operator*() const
+	{
+		return *operator->();
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	uint32_t CompressedPtr<T, Tag, Shift>::GetOffset() const
+	{
+		return offset;
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedScopedPtr<T, Tag, Shift>::CompressedScopedPtr()
+		: offset(0)
+	{
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedScopedPtr<T, Tag, Shift>::CompressedScopedPtr(T* ptr)
+		: offset(Arena::Encode(ptr))
+	{
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedScopedPtr<T, Tag, Shift>::CompressedScopedPtr(CompressedScopedPtr&& other) noexcept
+		: offset(other.offset)
+	{
+		other.offset = 0;
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedScopedPtr<T, Tag, Shift>& CompressedScopedPtr<T, Tag, Shift>::operator=(CompressedScopedPtr&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+
+			offset = other.offset;
+			other.offset = 0;
+		}
+
+		return *this;
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedScopedPtr<T, Tag, Shift>::~CompressedScopedPtr()
+	{
+		Clean();
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T* CompressedScopedPtr<T, Tag, Shift>::Get() const
+	{
+		return static_cast<T*>(Arena::Decode(offset));
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T* CompressedScopedPtr<T, Tag, Shift>::operator->() const
+	{
+		return reinterpret_cast<T*>(Arena::Base() + (uint64_t(offset) << Shift));
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T& CompressedScopedPtr<T, Tag, Shift>::Dereference() const
+	{
+		return *operator->();
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T& CompressedScopedPtr<T, Tag, Shift>::operator*() const
+	{
+		return *operator->();
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedPtr<T, Tag, Shift> CompressedScopedPtr<T, Tag, Shift>::GetCompressed() const
+	{
+		return CompressedPtr<T, Tag, Shift>(Get());
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	void CompressedScopedPtr<T, Tag, Shift>::Clean()
+	{
+		//if the pointer is not pointing to nothing, destroy the object and give its block back to the arena
+		if (offset != 0)
+		{
+			T* ptr = Get();
+			ptr->~T();
+			Arena::Deallocate(ptr, sizeof(T));
+			offset = 0;
+		}
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedRefPtr<T, Tag, Shift>::CompressedRefPtr()
+		: offset(0)
+	{
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedRefPtr<T, Tag, Shift>::CompressedRefPtr(Block* block)
+		: offset(Arena::Encode(block))
+	{
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedRefPtr<T, Tag, Shift>::CompressedRefPtr(const CompressedRefPtr& other)
+		: offset(other.offset)
+	{
+		if (offset != 0)
+			GetBlock()->refs++;
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedRefPtr<T, Tag, Shift>& CompressedRefPtr<T, Tag, Shift>::operator=(const CompressedRefPtr& other)
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+
+			offset = other.offset;
+			if (offset != 0)
+				GetBlock()->refs++;
+		}
+
+		return *this;
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedRefPtr<T, Tag, Shift>::CompressedRefPtr(CompressedRefPtr&& other) noexcept
+		: offset(other.offset)
+	{
+		other.offset = 0;
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedRefPtr<T, Tag, Shift>& CompressedRefPtr<T, Tag, Shift>::operator=(CompressedRefPtr&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+
+			offset = other.offset;
+			other.offset = 0;
+		}
+
+		return *this;
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedRefPtr<T, Tag, Shift>::~CompressedRefPtr()
+	{
+		Clean();
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T* CompressedRefPtr<T, Tag, Shift>::Get() const
+	{
+		return offset != 0 ? GetBlock()->Object() : nullptr;
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T* CompressedRefPtr<T, Tag, Shift>::operator->() const
+	{
+		return GetBlock()->Object();
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T& CompressedRefPtr<T, Tag, Shift>::Dereference() const
+	{
+		return *GetBlock()->Object();
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	T& CompressedRefPtr<T, Tag, Shift>::operator*() const
+	{
+		return *GetBlock()->Object();
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	size_t CompressedRefPtr<T, Tag, Shift>::GetRefCount() const
+	{
+		return offset != 0 ? GetBlock()->refs : 0;
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	CompressedPtr<T, Tag, Shift> CompressedRefPtr<T, Tag, Shift>::GetCompressed() const
+	{
+		return CompressedPtr<T, Tag, Shift>(Get());
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	typename CompressedRefPtr<T, Tag, Shift>::Block* CompressedRefPtr<T, Tag, Shift>::GetBlock() const
+	{
+		return reinterpret_cast<Block*>(Arena::Base() + (uint64_t(offset) << Shift));
+	}
+
+	template <typename T, typename Tag, unsigned Shift>
+	void CompressedRefPtr<T, Tag, Shift>::Clean()
+	{
+		if (offset == 0)
+			return;
+
+		//only the last pointer destroys the object and frees the block
+		Block* block = GetBlock();
+		if (--block->refs == 0)
+		{
+			block->Object()->~T();
+			Arena::Deallocate(block, sizeof(Block));
+		}
+
+		offset = 0;
+	}
+}
+
+#endif
@@ -0,0 +1,149 @@
+#pragma once
+#ifndef _COW_PTR_H
+#define _COW_PTR_H
+
+/**
+* CowPtr
+* Copy on write pointer built on top of RefPtr.
+*
+* Copying a CowPtr only shares the object. Read() never copies, Write() copies the object first if anyone else
+* is still sharing it, so every CowPtr behaves like its own value without defensive deep copies.
+* AtomicCowPtr uses the thread safe count, so copies can be read and written from different threads.
+* As with any value, a single CowPtr must not be written by one thread while another one copies or reads it.
+*
+* Usage
+* Ptr::CowPtr<Config> config = Ptr::InitCowPtr<Config>(parameters);
+* Ptr::CowPtr<Config> copy = config; //no copy of the Config yet
+* copy.Write().name = "copy"; //the Config is copied here, config is left untouched
+*/
+
+#include <utility>
+
+#include "Ptr.h"
+
+namespace Ptr
+{
+	//pointer that shares an object until one of its owners writes to it
+	template <typename T, typename Counter = RefCounter>
+	class PTR_TRIVIAL_ABI CowPtr
+	{
+	public:
+		//default constructor
+		CowPtr();
+		//constructor that takes in a pointer (CowPtr<T> ptr(new T);)
+		explicit CowPtr(T* ptr);
+		//constructor that shares the object of a reference pointer
+		explicit CowPtr(const RefPtr<T, Counter>& ref);
+
+		//functions that give read only access, these never copy
+		const T& Read() const;
+		const T* Get() const;
+		const T* operator->() const;
+		const T& operator*() const;
+
+		//gives write access, copies the object first if it is shared
+		T& Write();
+
+		//returns true if this is the only pointer to the object
+		bool IsUnique() const;
+
+		//returns the amount of pointers sharing the object
+		size_t GetRefCount() const;
+
+	private:
+		RefPtr<T, Counter> ref;
+	};
+
+	//copy on write pointer that can be shared between threads
+	template <typename T>
+	using AtomicCowPtr = CowPtr<T, AtomicRefCounter>;
+
+	//only holds a RefPtr, so it relocates the same way one does
+	template <typename T, typename Counter>
+	struct IsTriviallyRelocatable<CowPtr<T, Counter>> : IsTriviallyRelocatable<RefPtr<T, Counter>>
+	{
+		static_assert(sizeof(CowPtr<T, Counter>) == sizeof(RefPtr<T, Counter>), "CowPtr must hold only its RefPtr");
+		static_assert(std::is_standard_layout<CowPtr<T, Counter>>::value, "CowPtr must be standard layout");
+	};
+
+	//calls constructor for an object (CowPtr<T> ptr = InitCowPtr<T>(parameters);)
+	template <typename T, typename ... Args>
+	CowPtr<T> InitCowPtr(Args&& ... mArgs)
+	{
+		return CowPtr<T>(detail::NewObject<T>(std::forward<Args>(mArgs)...));
+	}
+
+	//calls constructor for an object (AtomicCowPtr<T> ptr = InitAtomicCowPtr<T>(parameters);)
+	template <typename T, typename ... Args>
+	AtomicCowPtr<T> InitAtomicCowPtr(Args&& ... mArgs)
+	{
+		return AtomicCowPtr<T>(detail::NewObject<T>(std::forward<Args>(mArgs)...));
+	}
+
+	template <typename T, typename Counter>
+	CowPtr<T, Counter>::CowPtr()
+		: ref()
+	{
+	}
+
+	template <typename T, typename Counter>
+	CowPtr<T, Counter>::CowPtr(T* ptr)
+		: ref(ptr)
+	{
+	}
+
+	template <typename T, typename Counter>
+	CowPtr<T, Counter>::CowPtr(const RefPtr<T, Counter>& ref)
+		: ref(ref)
+	{
+	}
+
+	template <typename T, typename Counter>
+	const T& CowPtr<T, Counter>::Read() const
+	{
+		return *ref;
+	}
+
+	template <typename T, typename Counter>
+	const T* CowPtr<T, Counter>::Get() const
+	{
+		return ref.Get();
+	}
+
+	template <typename T, typename Counter>
+	const T* CowPtr<T, Counter>::operator->() const
+	{
+		return ref.Get();
+	}
+
+	template <typename T, typename Counter>
+	const T& CowPtr<T, Counter>::operator*() const
+	{
+		return *ref;
+	}
+
+	template <typename T, typename Counter>
+	T& CowPtr<T, Counter>::Write()
+	{
+		//with the atomic counter the count is loaded with acquire, so seeing 1 means every other owner
+		//has finished reading before we start writing
+		if (ref.Get() != nullptr && !IsUnique())
+			ref = RefPtr<T, Counter>(detail::NewObject<T>(*ref));
+
+		return *ref;
+	}
+
+	template <typename T, typename Counter>
+	bool CowPtr<T, Counter>::IsUnique() const
+	{
+		return ref.GetRefCount() == 1;
+	}
+
+	template <typename T, typename Counter>
+	size_t CowPtr<T, Counter>::GetRefCount() const
+	{
+		return ref.GetRefCount();
+	}
+}
+
+#endif
@@ -0,0 +1,292 @@
+#pragma once
+#ifndef _INLINE_PTR_H
+#define _INLINE_PTR_H
+
+/**
+* InlinePtr
+* Owning pointer to a polymorphic object that keeps small objects inside of the pointer itself.
+*
+* An InlinePtr<Base, N> has the same interface as ScopedPtr<Base>, but an object of a derived type that fits in
+* N bytes is constructed in a buffer inside of the pointer instead of on the heap. Bigger objects, over aligned
+* objects, and objects that could throw while being moved are spilled to the heap.
+* Moving an InlinePtr moves the object into the new buffer, so the address of an inline object changes on a move.
+*
+* Usage
+* Ptr::InlinePtr<Strategy, 32> strategy = Ptr::InitInlinePtr<Strategy, FastStrategy, 32>(parameters);
+* strategy->Run();
+*/
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Ptr
+{
+	namespace detail
+	{
+		//functions that know the concrete type of a polymorphic object, one table exists per pair of types
+		template <typename Base>
+		struct PolyOps
+		{
+			//destroys the object, and frees it if it was not stored inline
+			void (*destroy)(Base* object, bool isInline);
+			//move constructs the object into storage and destroys the original
+			//nullptr when the type is never stored inline, objects on the heap do not move and do not have to be movable
+			Base* (*relocate)(Base* object, void* storage);
+			//copy constructs the object into storage, or onto the heap when storage is nullptr
+			//nullptr when the type can not be copied
+			Base* (*copy)(const Base* object, void* storage);
+		};
+
+		template <typename Base, typename Derived>
+		void PolyDestroy(Base* object, bool isInline)
+		{
+			Derived* derived = static_cast<Derived*>(object);
+			if (isInline)
+				derived->~Derived();
+			else
+				delete derived;
+		}
+
+		template <typename Base, typename Derived>
+		Base* PolyRelocate(Base* object, void* storage)
+		{
+			Derived* derived = static_cast<Derived*>(object);
+			Derived* moved = new (storage) Derived(std::move(*derived));
+			derived->~Derived();
+			return moved;
+		}
+
+		template <typename Base, typename Derived>
+		Base* PolyCopy(const Base* object, void* storage)
+		{
+			const Derived* derived = static_cast<const Derived*>(object);
+			if (storage != nullptr)
+				return new (storage) Derived(*derived);
+
+			return new Derived(*derived);
+		}
+
+		template <typename Base, typename Derived, bool Inline>
+		constexpr auto GetPolyRelocate() -> Base* (*)(Base*, void*)
+		{
+			if constexpr (Inline)
+				return &PolyRelocate<Base, Derived>;
+			else
+				return nullptr;
+		}
+
+		template <typename Base, typename Derived>
+		constexpr auto GetPolyCopy() -> Base* (*)(const Base*, void*)
+		{
+			if constexpr (std::is_copy_constructible<Derived>::value)
+				return &PolyCopy<Base, Derived>;
+			else
+				return nullptr;
+		}
+
+		//Inline is true if the object is stored inside of the pointer (see FitsInline)
+		template <typename Base, typename Derived, bool Inline>
+		const PolyOps<Base>* GetPolyOps()
+		{
+			static constexpr PolyOps<Base> ops = { &PolyDestroy<Base, Derived>, GetPolyRelocate<Base, Derived, Inline>(), GetPolyCopy<Base, Derived>() };
+			return &ops;
+		}
+
+		//storage for inline objects, an empty base when there is no room so it takes no space
+		template <size_t N>
+		struct InlineBuffer
+		{
+			alignas(std::max_align_t) unsigned char buffer[N];
+
+			void* Storage() { return buffer; }
+			//pointers into different objects can only be ordered with std::less
+			bool Holds(const void* ptr) const { return !std::less<const void*>()(ptr, buffer) && std::less<const void*>()(ptr, buffer + N); }
+		};
+
+		template <>
+		struct InlineBuffer<0>
+		{
+			void* Storage() { return nullptr; }
+			bool Holds(const void*) const { return false; }
+		};
+
+		//true if a Derived can live in an N byte buffer
+		template <typename Derived, size_t N>
+		struct FitsInline : std::integral_constant<bool,
+			sizeof(Derived) <= N && alignof(Derived) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<Derived>::value>
+		{
+		};
+	}
+
+	//pointer that owns a polymorphic object, keeping it inline when it fits in N bytes
+	template <typename Base, size_t N = 32>
+	class InlinePtr : private detail::InlineBuffer<N>
+	{
+	public:
+		//default constructor
+		InlinePtr();
+
+		//deleted functions to avoid copying of pointers
+		InlinePtr(const InlinePtr&) = delete;
+		InlinePtr& operator=(const InlinePtr&) = delete;
+
+		//rvalue constructor and move assignment operator, an inline object is moved into this buffer
+		InlinePtr(InlinePtr&& other) noexcept;
+		InlinePtr& operator=(InlinePtr&& other) noexcept;
+
+		//destructor
+		~InlinePtr();
+
+		//destroys the current object and constructs a new one (ptr.Emplace<Derived>(parameters);)
+		template <typename Derived = Base, typename ... Args>
+		Derived* Emplace(Args&& ... mArgs);
+
+		//functions that return the raw pointer
+		Base* Get() const;
+		Base* operator->() const;
+
+		//functions that dereferences pointer
+		Base& Dereference() const;
+		Base& operator*() const;
+
+		//returns true if the object is stored inside of the pointer
+		bool IsInline() const;
+
+	private:
+		using Buffer = detail::InlineBuffer<N>;
+
+		//takes the object out of other
+		void Steal(InlinePtr& other);
+
+		//function for cleanup
+		void Clean();
+
+	private:
+		Base* ptr;
+		const detail::PolyOps<Base>* ops;
+	};
+
+	//calls constructor for an object (InlinePtr<Base, N> ptr = InitInlinePtr<Base, Derived, N>(parameters);)
+	template <typename Base, typename Derived = Base, size_t N = 32, typename ... Args>
+	InlinePtr<Base, N> InitInlinePtr(Args&& ... mArgs)
+	{
+		InlinePtr<Base, N> ptr;
+		ptr.template Emplace<Derived>(std::forward<Args>(mArgs)...);
+		return ptr;
+	}
+
+	template <typename Base, size_t N>
+	InlinePtr<Base, N>::InlinePtr()
+		: ptr(nullptr), ops(nullptr)
+	{
+	}
+
+	template <typename Base, size_t N>
+	InlinePtr<Base, N>::InlinePtr(InlinePtr&& other) noexcept
+		: ptr(nullptr), ops(nullptr)
+	{
+		Steal(other);
+	}
+
+	template <typename Base, size_t N>
+	InlinePtr<Base, N>& InlinePtr<Base, N>::operator=(InlinePtr&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+			Steal(other);
+		}
+
+		return *this;
+	}
+
+	template <typename Base, size_t N>
+	InlinePtr<Base, N>::~InlinePtr()
+	{
+		Clean();
+	}
+
+	template <typename Base, size_t N>
+	template <typename Derived, typename ... Args>
+	Derived* InlinePtr<Base, N>::Emplace(Args&& ... mArgs)
+	{
+		static_assert(std::is_base_of<Base, Derived>::value || std::is_same<Base, Derived>::value, "Derived must derive from Base");
+
+		Clean();
+
+		Derived* object;
+		if constexpr (detail::FitsInline<Derived, N>::value)
+			object = new (Buffer::Storage()) Derived(std::forward<Args>(mArgs)...);
+		else
+			object = new Derived(std::forward<Args>(mArgs)...);
+
+		ptr = object;
+		ops = detail::GetPolyOps<Base, Derived, detail::FitsInline<Derived, N>::value>();
+		return object;
+	}
+
+	template <typename Base, size_t N>
+	Base* InlinePtr<Base, N>::Get() const
+	{
+		return ptr;
+	}
+
+	template <typename Base, size_t N>
+	Base* InlinePtr<Base, N>::operator->() const
+	{
+		return ptr;
+	}
+
+	template <typename Base, size_t N>
+	Base& InlinePtr<Base, N>::Dereference() const
+	{
+		return *ptr;
+	}
+
+	template <typename Base, size_t N>
+	Base& InlinePtr<Base, N>::operator*() const
+	{
+		return *ptr;
+	}
+
+	template <typename Base, size_t N>
+	bool InlinePtr<Base, N>::IsInline() const
+	{
+		return Buffer::Holds(ptr);
+	}
+
+	template <typename Base, size_t N>
+	void InlinePtr<Base, N>::Steal(InlinePtr& other)
+	{
+		if (other.ptr == nullptr)
+			return;
+
+		//heap objects just change owner, inline objects have to be moved into our buffer
+		if (other.IsInline())
+			ptr = other.ops->relocate(other.ptr, Buffer::Storage());
+		else
+			ptr = other.ptr;
+
+		ops = other.ops;
+
+		other.ptr = nullptr;
+		other.ops = nullptr;
+	}
+
+	template <typename Base, size_t N>
+	void InlinePtr<Base, N>::Clean()
+	{
+		//if the pointer is not pointing to nothing, destroy the object
+		if (ptr != nullptr)
+			ops->destroy(ptr, IsInline());
+
+		ptr = nullptr;
+		ops = nullptr;
+	}
+}
+
+#endif
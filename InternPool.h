@@ -0,0 +1,242 @@
+#pragma once
+#ifndef _INTERN_POOL_H
+#define _INTERN_POOL_H
+
+/**
+* InternPool
+* Hash consing pool that hands out one shared RefPtr for every distinct value.
+*
+* Interning a value returns the RefPtr of the equal value already in the pool, or adds a new one.
+* Equal values then share one object, so they can be compared by pointer.
+* The pool does not keep its values alive: the control block of every interned value removes its own entry
+* when the last RefPtr to it goes away.
+* Values can outlive the pool. The shards are counted by the pool and by every value in them,
+* so they stay around until the last of those is gone.
+* Interned values are handed out as RefPtr<const T>, changing one would break its place in the pool.
+*
+* InternPool is not thread safe. ConcurrentInternPool splits the pool into shards with their own lock,
+* and hands out AtomicRefPtr so the values can be shared between threads.
+*
+* Usage
+* Ptr::InternPool<std::string> symbols;
+* Ptr::RefPtr<const std::string> a = symbols.Intern("name");
+* Ptr::RefPtr<const std::string> b = symbols.Intern(std::string("name")); //a.Get() == b.Get()
+*/
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "Ptr.h"
+
+namespace Ptr
+{
+	namespace detail
+	{
+		//lock for pools that are only used from one thread
+		struct NullLock
+		{
+			void lock() {}
+			void unlock() {}
+		};
+
+		template <typename T, typename Hash>
+		struct InternHash
+		{
+			size_t operator()(const T* value) const { return Hash()(*value); }
+		};
+
+		template <typename T, typename Eq>
+		struct InternEq
+		{
+			bool operator()(const T* a, const T* b) const { return Eq()(*a, *b); }
+		};
+	}
+
+	//pool of unique values, the counter decides whether it can be shared between threads
+	template <typename T, typename Hash, typename Eq, typename Counter, size_t Shards>
+	class BasicInternPool
+	{
+	public:
+		static_assert(Shards > 0, "a pool needs at least one shard");
+		static_assert(!detail::IsRefCounted<T>::value, "objects that derive from RefCounted are their own block, they can not be interned");
+
+		//default constructor
+		BasicInternPool();
+
+		//deleted functions, the blocks of interned values point back at the pool
+		BasicInternPool(const BasicInternPool&) = delete;
+		BasicInternPool& operator=(const BasicInternPool&) = delete;
+
+		//destructor, values that are still referenced stay alive but can no longer be found
+		~BasicInternPool();
+
+		//returns the pointer to the value equal to value, adding it if there is none
+		RefPtr<const T, Counter> Intern(const T& value);
+		RefPtr<const T, Counter> Intern(T&& value);
+
+		//returns the amount of values in the pool
+		size_t Size() const;
+
+	private:
+		struct Shard;
+
+		struct Table;
+
+		//control block holding an interned value
+		struct Block : detail::RefBlock<Counter>
+		{
+			template <typename V>
+			Block(Table* table, Shard* shard, V&& value)
+				: detail::RefBlock<Counter>(1, &Destroy), table(table), shard(shard), value(std::forward<V>(value))
+			{
+			}
+
+			//called when the last pointer goes away, removes the entry before freeing the value
+			static void Destroy(detail::RefBlock<Counter>* block);
+
+			Table* table;
+			Shard* shard;
+			T value;
+		};
+
+		using Lock = typename std::conditional<std::is_same<Counter, RefCounter>::value, detail::NullLock, std::mutex>::type;
+
+		struct Shard
+		{
+			mutable Lock lock;
+			std::unordered_map<const T*, Block*, detail::InternHash<T, Hash>, detail::InternEq<T, Eq>> values;
+		};
+
+		//the shards, held by the pool and by every value in them
+		struct Table
+		{
+			Table()
+				: refs(1)
+			{
+			}
+
+			//drops one holder, and frees the table with the last one
+			static void Release(Table* table);
+
+			typename Counter::Type refs;
+			Shard shards[Shards];
+		};
+
+		//looks the value up, and constructs a new block from it if it is missing
+		template <typename V>
+		RefPtr<const T, Counter> Find(V&& value);
+
+	private:
+		Table* table;
+	};
+
+	//pool of unique values for a single thread
+	template <typename T, typename Hash = std::hash<T>, typename Eq = std::equal_to<T>>
+	using InternPool = BasicInternPool<T, Hash, Eq, RefCounter, 1>;
+
+	//pool of unique values that can be shared between threads, each shard has its own lock
+	template <typename T, typename Hash = std::hash<T>, typename Eq = std::equal_to<T>, size_t Shards = 16>
+	using ConcurrentInternPool = BasicInternPool<T, Hash, Eq, AtomicRefCounter, Shards>;
+
+	template <typename T, typename Hash, typename Eq, typename Counter, size_t Shards>
+	BasicInternPool<T, Hash, Eq, Counter, Shards>::BasicInternPool()
+		: table(detail::NewObject<Table>())
+	{
+	}
+
+	template <typename T, typename Hash, typename Eq, typename Counter, size_t Shards>
+	BasicInternPool<T, Hash, Eq, Counter, Shards>::~BasicInternPool()
+	{
+		//forget the live values, the shards stay around until the last of them is gone
+		for (Shard& shard : table->shards)
+		{
+			std::lock_guard<Lock> guard(shard.lock);
+			shard.values.clear();
+		}
+
+		Table::Release(table);
+	}
+
+	template <typename T, typename Hash, typename Eq, typename Counter, size_t Shards>
+	RefPtr<const T, Counter> BasicInternPool<T, Hash, Eq, Counter, Shards>::Intern(const T& value)
+	{
+		return Find(value);
+	}
+
+	template <typename T, typename Hash, typename Eq, typename Counter, size_t Shards>
+	RefPtr<const T, Counter> BasicInternPool<T, Hash, Eq, Counter, Shards>::Intern(T&& value)
+	{
+		return Find(std::move(value));
+	}
+
+	template <typename T, typename Hash, typename Eq, typename Counter, size_t Shards>
+	size_t BasicInternPool<T, Hash, Eq, Counter, Shards>::Size() const
+	{
+		size_t size = 0;
+		for (const Shard& shard : table->shards)
+		{
+			std::lock_guard<Lock> guard(shard.lock);
+			size += shard.values.size();
+		}
+
+		return size;
+	}
+
+	template <typename T, typename Hash, typename Eq, typename Counter, size_t Shards>
+	template <typename V>
+	RefPtr<const T, Counter> BasicInternPool<T, Hash, Eq, Counter, Shards>::Find(V&& value)
+	{
+		Shard& shard = table->shards[Shards > 1 ? Hash()(value) % Shards : 0];
+		std::lock_guard<Lock> guard(shard.lock);
+
+		auto found = shard.values.find(&value);
+		if (found != shard.values.end())
+		{
+			//the count may already have reached 0 on another thread, that value is on its way out
+			//and its entry gets replaced by a new one below
+			Block* block = found->second;
+			if (Counter::IncrementIfNotZero(block->refs))
+				return RefPtr<const T, Counter>(&block->value, block);
+		}
+
+		Block* block = detail::NewObject<Block>(table, &shard, std::forward<V>(value));
+		Counter::Increment(table->refs);
+
+		if (found != shard.values.end())
+			shard.values.erase(found);
+
+		shard.values.emplace(&block->value, block);
+		return RefPtr<const T, Counter>(&block->value, block);
+	}
+
+	template <typename T, typename Hash, typename Eq, typename Counter, size_t Shards>
+	void BasicInternPool<T, Hash, Eq, Counter, Shards>::Block::Destroy(detail::RefBlock<Counter>* block)
+	{
+		Block* self = static_cast<Block*>(block);
+		Table* table = self->table;
+
+		{
+			std::lock_guard<Lock> guard(self->shard->lock);
+
+			//only remove the entry if it is still ours, a new value may have replaced it already
+			auto found = self->shard->values.find(&self->value);
+			if (found != self->shard->values.end() && found->second == self)
+				self->shard->values.erase(found);
+		}
+
+		detail::DeleteObject(self);
+		Table::Release(table);
+	}
+
+	template <typename T, typename Hash, typename Eq, typename Counter, size_t Shards>
+	void BasicInternPool<T, Hash, Eq, Counter, Shards>::Table::Release(Table* table)
+	{
+		if (Counter::Decrement(table->refs) == 0)
+			detail::DeleteObject(table);
+	}
+}
+
+#endif
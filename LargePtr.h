@@ -0,0 +1,364 @@
+#pragma once
+#ifndef _LARGE_PTR_H
+#define _LARGE_PTR_H
+
+/**
+* LargePtr
+* Scoped pointer to a big array that is mapped straight from the system, backed by huge pages where possible.
+*
+* Random access into an array of several GB misses the TLB on almost every lookup with 4KB pages.
+* A LargeScopedPtr maps its memory with mmap and asks for huge pages, either transparent huge pages (MADV_HUGEPAGE)
+* or explicit ones from the huge page pool (MAP_HUGETLB), and unmaps it again in Clean().
+* If the kind of page that was asked for is not available it falls back to the next best one, down to normal pages,
+* and on systems without mmap to new[].
+*
+* The elements are value initialized like new T[count](), trivial types are left as the zeroes the system maps in.
+* Populate prefaults the whole array up front, so the first pass over it does not stall on page faults.
+*
+* Usage
+* Ptr::LargeOptions options;
+* options.pages = Ptr::PagePolicy::Explicit;
+* Ptr::LargeScopedPtr<uint64_t> table = Ptr::InitLargeScopedPtr<uint64_t>(size_t(1) << 30, options);
+* table[key % table.Size()] = value;
+*/
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define PTR_HAS_MMAP 1
+#endif
+
+namespace Ptr
+{
+	//kind of pages a LargeScopedPtr asks for
+	enum class PagePolicy
+	{
+		//normal pages
+		Normal,
+		//transparent huge pages, the kernel backs the memory with huge pages when it can
+		Transparent,
+		//pages from the huge page pool, falls back to transparent huge pages if the pool is empty
+		Explicit,
+	};
+
+	//options for a LargeScopedPtr
+	struct LargeOptions
+	{
+		PagePolicy pages = PagePolicy::Transparent;
+		//size of a huge page, the mapping is aligned and rounded up to it
+		size_t hugePageSize = size_t(2) << 20;
+		//prefault every page when the memory is mapped
+		bool populate = false;
+	};
+
+	//scoped pointer to an array of count objects mapped from the system
+	template <typename T>
+	class LargeScopedPtr
+	{
+	public:
+		//default constructor
+		LargeScopedPtr();
+		//constructor that maps and value initializes count objects (LargeScopedPtr<T> ptr(count, options);)
+		explicit LargeScopedPtr(size_t count, const LargeOptions& options = LargeOptions());
+
+		//deleted functions to avoid copying of pointers
+		LargeScopedPtr(const LargeScopedPtr&) = delete;
+		LargeScopedPtr& operator=(const LargeScopedPtr&) = delete;
+
+		//rvalue constructor and move assignment operator
+		LargeScopedPtr(LargeScopedPtr&& other) noexcept;
+		LargeScopedPtr& operator=(LargeScopedPtr&& other) noexcept;
+
+		//destructor
+		~LargeScopedPtr();
+
+		//functions that return the raw pointer
+		T* Get() const;
+		T& operator[](size_t index) const;
+
+		//returns the amount of objects
+		size_t Size() const;
+
+		//returns the kind of pages the memory was mapped with, Normal if it was not mapped at all
+		PagePolicy GetPagePolicy() const;
+
+	private:
+		//maps bytes of memory with the given kind of pages, sets mapped to the length of the mapping
+		void* Map(size_t bytes, PagePolicy pages, const LargeOptions& options);
+
+		//function for cleanup
+		void Clean();
+
+	private:
+		T* ptr;
+		size_t count;
+		//length of the mapping, 0 if the array came from new[]
+		size_t mapped;
+		PagePolicy pages;
+	};
+
+	//maps and value initializes count objects (LargeScopedPtr<T> ptr = InitLargeScopedPtr<T>(count, options);)
+	template <typename T>
+	LargeScopedPtr<T> InitLargeScopedPtr(size_t count, const LargeOptions& options = LargeOptions())
+	{
+		return LargeScopedPtr<T>(count, options);
+	}
+
+	template <typename T>
+	LargeScopedPtr<T>::LargeScopedPtr()
+		: ptr(nullptr), count(0), mapped(0), pages(PagePolicy::Normal)
+	{
+	}
+
+	template <typename T>
+	LargeScopedPtr<T>::LargeScopedPtr(size_t count, const LargeOptions& options)
+		: ptr(nullptr), count(count), mapped(0), pages(PagePolicy::Normal)
+	{
+		if (count == 0)
+			return;
+
+		if (count > size_t(-1) / sizeof(T))
+			throw std::bad_alloc();
+
+		size_t bytes = count * sizeof(T);
+
+		//try the kind of pages that was asked for first, then everything below it
+		void* memory = nullptr;
+		if (options.pages == PagePolicy::Explicit)
+		{
+			memory = Map(bytes, PagePolicy::Explicit, options);
+			pages = PagePolicy::Explicit;
+		}
+
+		if (memory == nullptr && options.pages != PagePolicy::Normal)
+		{
+			memory = Map(bytes, PagePolicy::Transparent, options);
+			pages = PagePolicy::Transparent;
+		}
+
+		if (memory == nullptr)
+		{
+			memory = Map(bytes, PagePolicy::Normal, options);
+			pages = PagePolicy::Normal;
+		}
+
+		//no mmap at all, use the heap
+		if (memory == nullptr)
+		{
+			ptr = new T[count]();
+			return;
+		}
+
+		ptr = static_cast<T*>(memory);
+
+		//mapped memory is already zeroed, which is what value initializing a trivial type would do
+		if constexpr (!std::is_trivially_default_constructible<T>::value)
+		{
+			size_t constructed = 0;
+			try
+			{
+				for (; constructed < count; constructed++)
+					new (ptr + constructed) T();
+			}
+			catch (...)
+			{
+				while (constructed > 0)
+					ptr[--constructed].~T();
+
+				this->count = constructed;
+				Clean();
+				throw;
+			}
+		}
+	}
+
+	template <typename T>
+	LargeScopedPtr<T>::LargeScopedPtr(LargeScopedPtr&& other) noexcept
+		: ptr(other.ptr), count(other.count), mapped(other.mapped), pages(other.pages)
+	{
+		other.ptr = nullptr;
+		other.count = 0;
+		other.mapped = 0;
+	}
+
+	template <typename T>
+	LargeScopedPtr<T>& LargeScopedPtr<T>::operator=(LargeScopedPtr&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+
+			ptr = other.ptr;
+			count = other.count;
+			mapped = other.mapped;
+			pages = other.pages;
+
+			other.ptr = nullptr;
+			other.count = 0;
+			other.mapped = 0;
+		}
+
+		return *this;
+	}
+
+	template <typename T>
+	LargeScopedPtr<T>::~LargeScopedPtr()
+	{
+		Clean();
+	}
+
+	template <typename T>
+	T* LargeScopedPtr<T>::Get() const
+	{
+		return ptr;
+	}
+
+	template <typename T>
+	T& LargeScopedPtr<T>::operator[](size_t index) const
+	{
+		return ptr[index];
+	}
+
+	template <typename T>
+	size_t LargeScopedPtr<T>::Size() const
+	{
+		return count;
+	}
+
+	template <typename T>
+	PagePolicy LargeScopedPtr<T>::GetPagePolicy() const
+	{
+		return pages;
+	}
+
+	template <typename T>
+	void* LargeScopedPtr<T>::Map(size_t bytes, PagePolicy pages, const LargeOptions& options)
+	{
+#ifdef PTR_HAS_MMAP
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+		size_t huge = options.hugePageSize > 0 ? options.hugePageSize : size_t(2) << 20;
+
+		if (pages == PagePolicy::Explicit)
+		{
+#ifdef MAP_HUGETLB
+			//the length of an explicit huge page mapping has to be a multiple of the huge page size
+			size_t length = (bytes + huge - 1) / huge * huge;
+			flags |= MAP_HUGETLB;
+
+#ifdef MAP_HUGE_SHIFT
+			//ask for the huge page size that was given, instead of the default one
+			int shift = 0;
+			while ((size_t(1) << shift) < huge)
+				shift++;
+
+			flags |= shift << MAP_HUGE_SHIFT;
+#endif
+#ifdef MAP_POPULATE
+			if (options.populate)
+				flags |= MAP_POPULATE;
+#endif
+
+			void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+			if (memory == MAP_FAILED)
+				return nullptr;
+
+			mapped = length;
+			return memory;
+#else
+			return nullptr;
+#endif
+		}
+
+		if (pages == PagePolicy::Transparent)
+		{
+#ifdef MADV_HUGEPAGE
+			//huge pages are only used for parts of the mapping that are aligned to them
+			//so map an extra huge page worth and cut off what is not needed on both ends
+			size_t length = (bytes + huge - 1) / huge * huge;
+			char* memory = static_cast<char*>(mmap(nullptr, length + huge, PROT_READ | PROT_WRITE, flags, -1, 0));
+			if (memory == MAP_FAILED)
+				return nullptr;
+
+			size_t head = (huge - reinterpret_cast<size_t>(memory) % huge) % huge;
+			if (head > 0)
+				munmap(memory, head);
+
+			munmap(memory + head + length, huge - head);
+			memory += head;
+
+			//the advice is only a hint, the mapping is fine without it
+			madvise(memory, length, MADV_HUGEPAGE);
+
+			//prefault after the advice, so the faults already get huge pages
+			if (options.populate)
+			{
+#ifdef MADV_POPULATE_WRITE
+				if (madvise(memory, length, MADV_POPULATE_WRITE) != 0)
+#endif
+				{
+					for (size_t offset = 0; offset < length; offset += 4096)
+						memory[offset] = 0;
+				}
+			}
+
+			mapped = length;
+			return memory;
+#else
+			return nullptr;
+#endif
+		}
+
+#ifdef MAP_POPULATE
+		if (options.populate)
+			flags |= MAP_POPULATE;
+#endif
+
+		void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (memory == MAP_FAILED)
+			return nullptr;
+
+		mapped = bytes;
+		return memory;
+#else
+		(void)bytes;
+		(void)pages;
+		(void)options;
+		return nullptr;
+#endif
+	}
+
+	template <typename T>
+	void LargeScopedPtr<T>::Clean()
+	{
+		if (ptr == nullptr)
+			return;
+
+#ifdef PTR_HAS_MMAP
+		if (mapped > 0)
+		{
+			if constexpr (!std::is_trivially_destructible<T>::value)
+			{
+				for (size_t i = count; i > 0; i--)
+					ptr[i - 1].~T();
+			}
+
+			munmap(ptr, mapped);
+		}
+		else
+#endif
+		{
+			delete[] ptr;
+		}
+
+		ptr = nullptr;
+		count = 0;
+		mapped = 0;
+	}
+}
+
+#endif
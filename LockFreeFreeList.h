@@ -0,0 +1,142 @@
+#pragma once
+#ifndef _LOCK_FREE_FREE_LIST_H
+#define _LOCK_FREE_FREE_LIST_H
+
+/**
+* LockFreeFreeList
+* Intrusive lock free stack of free blocks, shared between threads without a mutex.
+*
+* Nodes are blocks of memory that are not in use, the link to the next node is stored in the block itself.
+* The head is a TaggedAtomicPtr, its tag changes on every update, so a head that was popped and pushed back
+* in between (ABA) fails the compare and swap instead of corrupting the list.
+* Whole chains of nodes are pushed with a single compare and swap, so caches in front of the list can give back
+* a batch of blocks at once. Popping takes one node per compare and swap, nodes past the head may already be in use.
+*
+* A node that was popped may still be read by another thread that is about to fail its compare and swap,
+* so memory given to the list must stay mapped for as long as the list is in use, the way pools and slabs are.
+*
+* Usage
+* Ptr::LockFreeFreeList<Node> list;
+* list.Push(node);
+* Node* block = list.Pop();
+*/
+
+#include <atomic>
+#include <cstddef>
+
+#include "TaggedAtomicPtr.h"
+
+namespace Ptr
+{
+	//stack of free nodes, Node must have a Node* next member
+	template <typename Node>
+	class LockFreeFreeList
+	{
+	public:
+		//default constructor
+		LockFreeFreeList();
+
+		//deleted functions, the nodes belong to whoever made them
+		LockFreeFreeList(const LockFreeFreeList&) = delete;
+		LockFreeFreeList& operator=(const LockFreeFreeList&) = delete;
+
+		//pushes one node
+		void Push(Node* node);
+		//pushes a chain of nodes linked from first to last
+		void PushBatch(Node* first, Node* last);
+
+		//pops one node, returns nullptr if the list is empty
+		Node* Pop();
+		//pops up to max nodes as one chain ending in nullptr, count is set to the amount that was popped
+		//the nodes are popped one at a time, another thread may take nodes in between
+		Node* PopBatch(size_t max, size_t& count);
+		//pops every node
+		Node* PopAll();
+
+		//returns true if the list was empty when it was looked at
+		bool Empty() const;
+
+	private:
+		TaggedAtomicPtr<Node> head;
+	};
+
+	template <typename Node>
+	LockFreeFreeList<Node>::LockFreeFreeList()
+		: head()
+	{
+	}
+
+	template <typename Node>
+	void LockFreeFreeList<Node>::Push(Node* node)
+	{
+		PushBatch(node, node);
+	}
+
+	template <typename Node>
+	void LockFreeFreeList<Node>::PushBatch(Node* first, Node* last)
+	{
+		TaggedPtr<Node> current = head.Load(std::memory_order_relaxed);
+		do
+		{
+			last->next = current.ptr;
+		} while (!head.CompareExchangeWeak(current, first, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	template <typename Node>
+	Node* LockFreeFreeList<Node>::Pop()
+	{
+		TaggedPtr<Node> current = head.Load(std::memory_order_acquire);
+
+		while (current.ptr != nullptr)
+		{
+			//the node may have been popped and handed out by another thread already, then next is whatever it holds now
+			//but the tag has changed as well, so the swap fails and the value is never used
+			if (head.CompareExchangeWeak(current, current.ptr->next, std::memory_order_acquire, std::memory_order_acquire))
+				return current.ptr;
+		}
+
+		return nullptr;
+	}
+
+	template <typename Node>
+	Node* LockFreeFreeList<Node>::PopBatch(size_t max, size_t& count)
+	{
+		//only the first node is safe to read before it is ours, nodes past it can already be in use
+		//so the chain is built one swap at a time instead of walking it in place
+		Node* first = nullptr;
+		Node* last = nullptr;
+		count = 0;
+
+		while (count < max)
+		{
+			Node* node = Pop();
+			if (node == nullptr)
+				break;
+
+			node->next = nullptr;
+			if (last != nullptr)
+				last->next = node;
+			else
+				first = node;
+
+			last = node;
+			count++;
+		}
+
+		return first;
+	}
+
+	template <typename Node>
+	Node* LockFreeFreeList<Node>::PopAll()
+	{
+		return head.Exchange(nullptr, std::memory_order_acquire).ptr;
+	}
+
+	template <typename Node>
+	bool LockFreeFreeList<Node>::Empty() const
+	{
+		return head.Load(std::memory_order_relaxed).ptr == nullptr;
+	}
+}
+
+#endif
@@ -0,0 +1,238 @@
+#pragma once
+#ifndef _MPMC_QUEUE_H
+#define _MPMC_QUEUE_H
+
+/**
+* MpmcQueue
+* Bounded lock free queue that moves ScopedPtr ownership between any number of producers and consumers.
+*
+* Based on Dmitry Vyukov's bounded MPMC queue: every cell has a sequence number that tells producers and consumers
+* whether it is theirs to fill or empty, so claiming a cell is a single compare and swap on the position and
+* producers and consumers never touch the same counter.
+* The batch functions claim a whole run of cells with one compare and swap.
+*
+* Pushing releases the ScopedPtr only once its object is in the queue, a push into a full queue leaves it untouched.
+* Popping hands the object back in a ScopedPtr, and destroying the queue destroys whatever is left in it,
+* so an object is never owned twice or lost on the way.
+*
+* Usage
+* Ptr::MpmcQueue<Job> queue(1024);
+* queue.Push(Ptr::InitScopedPtr<Job>(parameters)); //producer
+* Ptr::ScopedPtr<Job> job = queue.TryPop(); //consumer, job.Get() is nullptr if the queue was empty
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Ptr.h"
+
+namespace Ptr
+{
+	//bounded queue of owned objects, safe to push and pop from any thread
+	template <typename T>
+	class MpmcQueue
+	{
+	public:
+		//constructor, the capacity is rounded up to a power of 2
+		explicit MpmcQueue(size_t capacity);
+
+		//deleted functions, the queue owns its objects
+		MpmcQueue(const MpmcQueue&) = delete;
+		MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+		//destructor, destroys the objects still in the queue
+		~MpmcQueue();
+
+		//moves the object into the queue, returns false and leaves ptr as it was if the queue is full
+		bool Push(ScopedPtr<T>&& ptr);
+		//moves up to count objects into the queue in order, returns the amount that was pushed
+		//the ones that were pushed are left empty, the rest are left as they were
+		size_t PushBatch(ScopedPtr<T>* ptrs, size_t count);
+
+		//takes the oldest object out of the queue, returns an empty pointer if there is none
+		ScopedPtr<T> TryPop();
+		//takes up to max objects out of the queue into out, returns the amount that was popped
+		size_t PopBatch(ScopedPtr<T>* out, size_t max);
+
+		//returns the amount of objects the queue can hold
+		size_t Capacity() const;
+		//returns the amount of objects in the queue, only a snapshot while other threads are using it
+		size_t Size() const;
+
+	private:
+		struct Cell
+		{
+			std::atomic<size_t> sequence;
+			T* object;
+		};
+
+		//the positions are written by different threads, keep them on their own cache lines
+		static constexpr size_t CacheLine = 64;
+
+	private:
+		Cell* cells;
+		size_t mask;
+
+		alignas(CacheLine) std::atomic<size_t> pushPosition;
+		alignas(CacheLine) std::atomic<size_t> popPosition;
+	};
+
+	template <typename T>
+	MpmcQueue<T>::MpmcQueue(size_t capacity)
+		: cells(nullptr), mask(0), pushPosition(0), popPosition(0)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size *= 2;
+
+		cells = new Cell[size];
+		mask = size - 1;
+
+		//a cell is free for the push at position p when its sequence is p
+		for (size_t i = 0; i < size; i++)
+		{
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+			cells[i].object = nullptr;
+		}
+	}
+
+	template <typename T>
+	MpmcQueue<T>::~MpmcQueue()
+	{
+		while (TryPop().Get() != nullptr)
+		{
+		}
+
+		delete[] cells;
+	}
+
+	template <typename T>
+	bool MpmcQueue<T>::Push(ScopedPtr<T>&& ptr)
+	{
+		return PushBatch(&ptr, 1) == 1;
+	}
+
+	template <typename T>
+	size_t MpmcQueue<T>::PushBatch(ScopedPtr<T>* ptrs, size_t count)
+	{
+		if (count == 0)
+			return 0;
+
+		size_t position = pushPosition.load(std::memory_order_relaxed);
+		size_t claimed;
+
+		while (true)
+		{
+			//count the free cells in a row from position
+			claimed = 0;
+			intptr_t difference = 0;
+			while (claimed < count && claimed <= mask)
+			{
+				difference = intptr_t(cells[(position + claimed) & mask].sequence.load(std::memory_order_acquire)) - intptr_t(position + claimed);
+				if (difference != 0)
+					break;
+
+				claimed++;
+			}
+
+			if (claimed == 0)
+			{
+				//the cell still holds the object from a lap ago, the queue is full
+				if (difference < 0)
+					return 0;
+
+				//another producer got here first
+				position = pushPosition.load(std::memory_order_relaxed);
+				continue;
+			}
+
+			if (pushPosition.compare_exchange_weak(position, position + claimed, std::memory_order_relaxed))
+				break;
+		}
+
+		//the cells are ours, fill them and hand each one to the consumers
+		for (size_t i = 0; i < claimed; i++)
+		{
+			Cell& cell = cells[(position + i) & mask];
+			cell.object = ptrs[i].Release();
+			cell.sequence.store(position + i + 1, std::memory_order_release);
+		}
+
+		return claimed;
+	}
+
+	template <typename T>
+	ScopedPtr<T> MpmcQueue<T>::TryPop()
+	{
+		ScopedPtr<T> ptr;
+		PopBatch(&ptr, 1);
+		return ptr;
+	}
+
+	template <typename T>
+	size_t MpmcQueue<T>::PopBatch(ScopedPtr<T>* out, size_t max)
+	{
+		if (max == 0)
+			return 0;
+
+		size_t position = popPosition.load(std::memory_order_relaxed);
+		size_t claimed;
+
+		while (true)
+		{
+			//count the filled cells in a row from position
+			claimed = 0;
+			intptr_t difference = 0;
+			while (claimed < max && claimed <= mask)
+			{
+				difference = intptr_t(cells[(position + claimed) & mask].sequence.load(std::memory_order_acquire)) - intptr_t(position + claimed + 1);
+				if (difference != 0)
+					break;
+
+				claimed++;
+			}
+
+			if (claimed == 0)
+			{
+				//the cell has not been filled yet, the queue is empty
+				if (difference < 0)
+					return 0;
+
+				//another consumer got here first
+				position = popPosition.load(std::memory_order_relaxed);
+				continue;
+			}
+
+			if (popPosition.compare_exchange_weak(position, position + claimed, std::memory_order_relaxed))
+				break;
+		}
+
+		//take the objects and free each cell for the push one lap ahead
+		for (size_t i = 0; i < claimed; i++)
+		{
+			Cell& cell = cells[(position + i) & mask];
+			out[i] = ScopedPtr<T>(cell.object);
+			cell.object = nullptr;
+			cell.sequence.store(position + i + mask + 1, std::memory_order_release);
+		}
+
+		return claimed;
+	}
+
+	template <typename T>
+	size_t MpmcQueue<T>::Capacity() const
+	{
+		return mask + 1;
+	}
+
+	template <typename T>
+	size_t MpmcQueue<T>::Size() const
+	{
+		size_t popped = popPosition.load(std::memory_order_relaxed);
+		size_t pushed = pushPosition.load(std::memory_order_relaxed);
+		return pushed > popped ? pushed - popped : 0;
+	}
+}
+
+#endif
@@ -0,0 +1,244 @@
+#pragma once
+#ifndef _MPSC_QUEUE_H
+#define _MPSC_QUEUE_H
+
+/**
+* MpscQueue
+* Intrusive queue of AtomicRefPtr messages from any number of producers to a single consumer, like an actor mailbox.
+*
+* Messages derive from MpscNode, which holds the link to the next message and the block of the reference
+* that was pushed, so pushing a message allocates nothing.
+* Based on Dmitry Vyukov's intrusive MPSC queue: a push is a single atomic exchange of the back of the queue
+* followed by a store into the previous message, producers never wait for each other or for the consumer.
+*
+* The reference of a pushed pointer is moved into the queue as it is, and moved out again into the pointer
+* the consumer gets, the count is not touched on the way.
+* A message can only be in one queue at a time, there is only one link in it.
+* The consumer may briefly see the queue as empty while a producer is between its exchange and its store.
+*
+* Usage
+* struct Letter : Ptr::MpscNode { std::string text; };
+* Ptr::MpscQueue<Letter> mailbox;
+* mailbox.Push(Ptr::InitAtomicRefPtr<Letter>()); //any thread
+* mailbox.Drain([](Ptr::AtomicRefPtr<Letter>&& letter) { Read(letter->text); }); //consumer thread
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "Ptr.h"
+
+namespace Ptr
+{
+	//base of messages that can be pushed into an MpscQueue
+	struct MpscNode
+	{
+		MpscNode()
+			: next(nullptr), block(nullptr)
+		{
+		}
+
+		//the link belongs to whatever queue the message is in, copies start out of any queue
+		MpscNode(const MpscNode&)
+			: next(nullptr), block(nullptr)
+		{
+		}
+
+		MpscNode& operator=(const MpscNode&) { return *this; }
+
+		std::atomic<MpscNode*> next;
+		//block of the reference the message was pushed with, while it is in a queue
+		detail::RefBlock<AtomicRefCounter>* block;
+	};
+
+	//queue of messages pushed from any thread and popped from one
+	template <typename T>
+	class MpscQueue
+	{
+	public:
+		static_assert(std::is_base_of<MpscNode, T>::value, "messages have to derive from MpscNode");
+
+		//default constructor
+		MpscQueue();
+
+		//deleted functions, the messages link to the stub of the queue
+		MpscQueue(const MpscQueue&) = delete;
+		MpscQueue& operator=(const MpscQueue&) = delete;
+
+		//destructor, releases the messages still in the queue
+		~MpscQueue();
+
+		//moves the message into the queue, empty pointers are ignored, can be called from any thread
+		void Push(AtomicRefPtr<T>&& message);
+
+		//the functions below can only be called from the consumer thread
+
+		//takes the oldest message out of the queue, returns an empty pointer if there is none
+		AtomicRefPtr<T> TryPop();
+		//takes up to max messages out of the queue into out, returns the amount that was popped
+		size_t PopBatch(AtomicRefPtr<T>* out, size_t max);
+		//passes up to max messages to function (function(AtomicRefPtr<T>&& message)), returns the amount that was passed
+		template <typename Function>
+		size_t Drain(Function&& function, size_t max = size_t(-1));
+
+		//returns true if there was no message to pop when it was looked at
+		bool Empty() const;
+
+	private:
+		//links node at the back of the queue
+		void Link(MpscNode* node);
+		//unlinks the node at the front of the queue, returns nullptr if there is none
+		MpscNode* Unlink();
+		//gives back the reference node was pushed with
+		static AtomicRefPtr<T> Adopt(MpscNode* node);
+
+	private:
+		//producers exchange the back, only the consumer touches the front
+		alignas(64) std::atomic<MpscNode*> back;
+		alignas(64) MpscNode* front;
+		//the queue always holds at least one node, the stub takes that place when there are no messages
+		MpscNode stub;
+	};
+
+	template <typename T>
+	MpscQueue<T>::MpscQueue()
+		: back(&stub), front(&stub), stub()
+	{
+	}
+
+	template <typename T>
+	MpscQueue<T>::~MpscQueue()
+	{
+		while (MpscNode* node = Unlink())
+			Adopt(node);
+	}
+
+	template <typename T>
+	void MpscQueue<T>::Push(AtomicRefPtr<T>&& message)
+	{
+		T* object = message.Get();
+		if (object == nullptr)
+			return;
+
+		//the queue takes over the reference of message
+		MpscNode* node = object;
+		node->block = detail::RefPtrAccess::Detach(message);
+		Link(node);
+	}
+
+	template <typename T>
+	AtomicRefPtr<T> MpscQueue<T>::TryPop()
+	{
+		MpscNode* node = Unlink();
+		if (node == nullptr)
+			return AtomicRefPtr<T>();
+
+		return Adopt(node);
+	}
+
+	template <typename T>
+	size_t MpscQueue<T>::PopBatch(AtomicRefPtr<T>* out, size_t max)
+	{
+		size_t popped = 0;
+		while (popped < max)
+		{
+			MpscNode* node = Unlink();
+			if (node == nullptr)
+				break;
+
+			out[popped++] = Adopt(node);
+		}
+
+		return popped;
+	}
+
+	template <typename T>
+	template <typename Function>
+	size_t MpscQueue<T>::Drain(Function&& function, size_t max)
+	{
+		size_t drained = 0;
+		while (drained < max)
+		{
+			MpscNode* node = Unlink();
+			if (node == nullptr)
+				break;
+
+			//the next message is usually already linked, start loading it while this one is handled
+			PTR_PREFETCH(front);
+
+			function(Adopt(node));
+			drained++;
+		}
+
+		return drained;
+	}
+
+	template <typename T>
+	bool MpscQueue<T>::Empty() const
+	{
+		//any node but the stub at the front is a message
+		return front == &stub && stub.next.load(std::memory_order_acquire) == nullptr;
+	}
+
+	template <typename T>
+	void MpscQueue<T>::Link(MpscNode* node)
+	{
+		node->next.store(nullptr, std::memory_order_relaxed);
+
+		//the exchange orders the producers, the store hands the node to the consumer
+		MpscNode* previous = back.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	template <typename T>
+	MpscNode* MpscQueue<T>::Unlink()
+	{
+		MpscNode* node = front;
+		MpscNode* next = node->next.load(std::memory_order_acquire);
+
+		//skip the stub
+		if (node == &stub)
+		{
+			if (next == nullptr)
+				return nullptr;
+
+			front = next;
+			node = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+
+		if (next != nullptr)
+		{
+			front = next;
+			return node;
+		}
+
+		//node is the last one linked, unless a producer already exchanged the back and has not linked its node yet
+		if (node != back.load(std::memory_order_acquire))
+			return nullptr;
+
+		//put the stub behind it, so node can leave without the queue becoming empty
+		Link(&stub);
+
+		next = node->next.load(std::memory_order_acquire);
+		if (next != nullptr)
+		{
+			front = next;
+			return node;
+		}
+
+		return nullptr;
+	}
+
+	template <typename T>
+	AtomicRefPtr<T> MpscQueue<T>::Adopt(MpscNode* node)
+	{
+		detail::RefBlock<AtomicRefCounter>* block = node->block;
+		node->block = nullptr;
+		return AtomicRefPtr<T>(static_cast<T*>(node), block);
+	}
+}
+
+#endif
@@ -0,0 +1,373 @@
+#pragma once
+#ifndef _OBJECT_POOL_H
+#define _OBJECT_POOL_H
+
+/**
+* ObjectPool
+* Pool of reusable objects handed out as PooledPtr.
+*
+* A PooledPtr is a ScopedPtr whose deleter gives the object back to its pool instead of deleting it,
+* so objects that are expensive to build are constructed once and then reused.
+* Every thread keeps a small cache of free objects in front of the pool, acquiring and releasing only touch
+* that cache. The shared store behind it is only locked to move a batch of objects in or out of a cache.
+*
+* The pool keeps at most capacity objects in its shared store (plus what sits in the thread caches),
+* objects released past that are deleted. The reset hook is called on every object as it comes back.
+* A pool must outlive the PooledPtrs it hands out.
+*
+* Usage
+* Ptr::ObjectPool<Buffer> pool(256, [](Buffer& buffer) { buffer.Clear(); });
+* Ptr::PooledPtr<Buffer> buffer = pool.Acquire();
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Ptr.h"
+
+namespace Ptr
+{
+	namespace detail
+	{
+		//state shared by a pool and every thread cache in front of it
+		//the pool and each cache own it, so a thread that exits after the pool is gone can still give its objects back
+		template <typename T>
+		struct PoolCore
+		{
+			std::atomic<size_t> owners;
+			size_t capacity;
+			size_t cacheSize;
+			std::function<T*()> create;
+			std::function<void(T&)> reset;
+
+			std::mutex lock;
+			std::vector<T*> store;
+			std::atomic<bool> closed;
+
+			//moves up to count objects from the store into objects
+			void Refill(std::vector<T*>& objects, size_t count);
+			//moves objects back into the store, deleting what does not fit
+			void Flush(std::vector<T*>& objects, size_t count);
+
+			//functions to add and drop an owner, the last owner deletes the core
+			void AddOwner();
+			void DropOwner();
+		};
+
+		//free objects a thread keeps for one pool
+		template <typename T>
+		struct PoolCache
+		{
+			PoolCore<T>* core;
+			std::vector<T*> objects;
+		};
+
+		//every cache of a thread, for the pools of one type
+		template <typename T>
+		struct PoolCaches
+		{
+			~PoolCaches();
+
+			//returns the cache of this thread for a pool
+			static PoolCache<T>& Get(PoolCore<T>* core);
+			//gives back the cache of this thread for a pool that is closing
+			static void Drop(PoolCore<T>* core);
+
+			//returns the caches of this thread
+			static PoolCaches& Local();
+
+			std::vector<PoolCache<T>> caches;
+		};
+	}
+
+	//deleter that gives objects back to the pool they came from
+	template <typename T>
+	struct PoolDeleter
+	{
+		PoolDeleter();
+		explicit PoolDeleter(detail::PoolCore<T>* pool);
+
+		void operator()(T* ptr) const;
+
+		detail::PoolCore<T>* pool;
+	};
+
+	//scoped pointer to an object that goes back to its pool when the pointer is cleaned
+	template <typename T>
+	using PooledPtr = ScopedPtr<T, PoolDeleter<T>>;
+
+	//pool of reusable objects
+	template <typename T>
+	class ObjectPool
+	{
+	public:
+		//constructor for pools of default constructed objects (ObjectPool<T> pool(capacity, reset);)
+		//reset is called on every object that comes back
+		template <typename U = T, typename = typename std::enable_if<std::is_default_constructible<U>::value>::type>
+		explicit ObjectPool(size_t capacity = 1024, std::function<void(T&)> reset = nullptr);
+		//constructor (ObjectPool<T> pool(capacity, reset, create);)
+		//create makes new objects when the pool is empty, objects made by it must be deletable with delete
+		//without a create function objects are default constructed, a T without a default constructor throws std::invalid_argument
+		ObjectPool(size_t capacity, std::function<void(T&)> reset, std::function<T*()> create, size_t cacheSize = 32);
+
+		//deleted functions, the pointers that were handed out point back at the pool
+		ObjectPool(const ObjectPool&) = delete;
+		ObjectPool& operator=(const ObjectPool&) = delete;
+
+		//destructor, deletes every free object
+		~ObjectPool();
+
+		//returns a free object, creating one if there is none
+		PooledPtr<T> Acquire();
+
+		//creates objects until the shared store holds count of them
+		void Reserve(size_t count);
+
+		//returns the amount of objects in the shared store
+		size_t Size() const;
+
+	private:
+		detail::PoolCore<T>* core;
+	};
+
+	template <typename T>
+	void detail::PoolCore<T>::Refill(std::vector<T*>& objects, size_t count)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		while (count > 0 && !store.empty())
+		{
+			objects.push_back(store.back());
+			store.pop_back();
+			count--;
+		}
+	}
+
+	template <typename T>
+	void detail::PoolCore<T>::Flush(std::vector<T*>& objects, size_t count)
+	{
+		std::vector<T*> extra;
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			while (count > 0 && !objects.empty())
+			{
+				if (closed || store.size() >= capacity)
+					extra.push_back(objects.back());
+				else
+					store.push_back(objects.back());
+
+				objects.pop_back();
+				count--;
+			}
+		}
+
+		//delete outside of the lock, destructors can be slow
+		for (T* object : extra)
+			delete object;
+	}
+
+	template <typename T>
+	void detail::PoolCore<T>::AddOwner()
+	{
+		owners.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template <typename T>
+	void detail::PoolCore<T>::DropOwner()
+	{
+		if (owners.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete this;
+	}
+
+	template <typename T>
+	detail::PoolCaches<T>::~PoolCaches()
+	{
+		//the thread is exiting, give everything back
+		for (PoolCache<T>& cache : caches)
+		{
+			cache.core->Flush(cache.objects, cache.objects.size());
+			cache.core->DropOwner();
+		}
+	}
+
+	template <typename T>
+	detail::PoolCache<T>& detail::PoolCaches<T>::Get(PoolCore<T>* core)
+	{
+		PoolCaches<T>& local = Local();
+
+		//a thread only ever uses a handful of pools of the same type, a linear search is faster than a map
+		for (PoolCache<T>& cache : local.caches)
+		{
+			if (cache.core == core)
+				return cache;
+		}
+
+		//before adding a cache, give back the ones of pools that have been destroyed since
+		for (size_t i = 0; i < local.caches.size();)
+		{
+			if (local.caches[i].core->closed.load(std::memory_order_relaxed))
+			{
+				Drop(local.caches[i].core);
+				continue;
+			}
+
+			i++;
+		}
+
+		core->AddOwner();
+		local.caches.push_back(PoolCache<T>{ core, {} });
+		local.caches.back().objects.reserve(core->cacheSize * 2);
+		return local.caches.back();
+	}
+
+	template <typename T>
+	void detail::PoolCaches<T>::Drop(PoolCore<T>* core)
+	{
+		PoolCaches<T>& local = Local();
+
+		for (size_t i = 0; i < local.caches.size(); i++)
+		{
+			if (local.caches[i].core == core)
+			{
+				core->Flush(local.caches[i].objects, local.caches[i].objects.size());
+				local.caches.erase(local.caches.begin() + i);
+				core->DropOwner();
+				return;
+			}
+		}
+	}
+
+	template <typename T>
+	detail::PoolCaches<T>& detail::PoolCaches<T>::Local()
+	{
+		static thread_local PoolCaches<T> local;
+		return local;
+	}
+
+	template <typename T>
+	PoolDeleter<T>::PoolDeleter()
+		: pool(nullptr)
+	{
+	}
+
+	template <typename T>
+	PoolDeleter<T>::PoolDeleter(detail::PoolCore<T>* pool)
+		: pool(pool)
+	{
+	}
+
+	template <typename T>
+	void PoolDeleter<T>::operator()(T* ptr) const
+	{
+		if (pool == nullptr)
+		{
+			delete ptr;
+			return;
+		}
+
+		if (pool->reset)
+			pool->reset(*ptr);
+
+		detail::PoolCache<T>& cache = detail::PoolCaches<T>::Get(pool);
+		cache.objects.push_back(ptr);
+
+		//once the cache is full, half of it goes back to the shared store in one batch
+		if (cache.objects.size() > pool->cacheSize)
+			pool->Flush(cache.objects, cache.objects.size() / 2);
+	}
+
+	template <typename T>
+	template <typename U, typename>
+	ObjectPool<T>::ObjectPool(size_t capacity, std::function<void(T&)> reset)
+		: ObjectPool(capacity, std::move(reset), nullptr)
+	{
+	}
+
+	template <typename T>
+	ObjectPool<T>::ObjectPool(size_t capacity, std::function<void(T&)> reset, std::function<T*()> create, size_t cacheSize)
+		: core(nullptr)
+	{
+		//checked before anything is allocated, so nothing has to be undone
+		if (!create && !std::is_default_constructible<T>::value)
+			throw std::invalid_argument("ObjectPool needs a create function for a type without a default constructor");
+
+		core = new detail::PoolCore<T>();
+
+		core->owners.store(1, std::memory_order_relaxed);
+		core->capacity = capacity;
+		core->cacheSize = cacheSize > 0 ? cacheSize : 1;
+		core->reset = std::move(reset);
+		core->closed.store(false, std::memory_order_relaxed);
+
+		//without a create function objects are default constructed
+		if (create)
+			core->create = std::move(create);
+		else if constexpr (std::is_default_constructible<T>::value)
+			core->create = []() { return new T(); };
+	}
+
+	template <typename T>
+	ObjectPool<T>::~ObjectPool()
+	{
+		std::vector<T*> objects;
+
+		//close the store, caches of other threads delete their objects when they flush
+		{
+			std::lock_guard<std::mutex> guard(core->lock);
+			core->closed.store(true, std::memory_order_relaxed);
+			objects.swap(core->store);
+		}
+
+		for (T* object : objects)
+			delete object;
+
+		//give back the cache of this thread now, other threads give theirs back when they notice or exit
+		detail::PoolCaches<T>::Drop(core);
+		core->DropOwner();
+	}
+
+	template <typename T>
+	PooledPtr<T> ObjectPool<T>::Acquire()
+	{
+		detail::PoolCache<T>& cache = detail::PoolCaches<T>::Get(core);
+
+		//take half a cache worth from the shared store when we run out
+		if (cache.objects.empty())
+			core->Refill(cache.objects, (core->cacheSize + 1) / 2);
+
+		if (!cache.objects.empty())
+		{
+			T* object = cache.objects.back();
+			cache.objects.pop_back();
+			return PooledPtr<T>(object, PoolDeleter<T>(core));
+		}
+
+		return PooledPtr<T>(core->create(), PoolDeleter<T>(core));
+	}
+
+	template <typename T>
+	void ObjectPool<T>::Reserve(size_t count)
+	{
+		std::vector<T*> objects;
+		for (size_t i = Size(); i < count; i++)
+			objects.push_back(core->create());
+
+		core->Flush(objects, objects.size());
+	}
+
+	template <typename T>
+	size_t ObjectPool<T>::Size() const
+	{
+		std::lock_guard<std::mutex> guard(core->lock);
+		return core->store.size();
+	}
+}
+
+#endif
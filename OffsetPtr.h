@@ -0,0 +1,1026 @@
+#pragma once
+#ifndef _OFFSET_PTR_H
+#define _OFFSET_PTR_H
+
+/**
+* OffsetPtr
+* Position independent pointers for memory mapped files and shared memory.
+*
+* An OffsetPtr stores the distance from itself to the object it points to instead of an absolute address,
+* so a structure built out of them stays valid no matter where its memory gets mapped.
+* A Segment is a region of memory (a mapped file, a shared memory segment, or any buffer) with a small allocator
+* in its header. Everything the allocator needs is stored as offsets too, so a segment can be written by one process,
+* mapped somewhere else by another, and used straight away without any fix ups.
+*
+* Anything stored inside a segment must itself be position independent: no absolute pointers, no virtual functions.
+*
+* Usage
+* Ptr::MappedSegment file = Ptr::MappedSegment::OpenFile("index.bin", size_t(1) << 30);
+* Ptr::OffsetRefPtr<Index> index = Ptr::InitOffsetRefPtr<Index>(file.GetSegment(), parameters);
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PTR_HAS_MMAP 1
+#endif
+
+namespace Ptr
+{
+	namespace detail
+	{
+		//backs off while a spin lock is taken, a few pauses first and then the rest of the time slice
+		void SpinWait(unsigned& spins);
+
+#ifdef PTR_HAS_MMAP
+		//identifies this process by its pid and the low bits of its start time, so a reused pid is not taken for it
+		uint64_t CurrentProcess();
+		//returns true if the process an identifier from CurrentProcess belongs to no longer exists
+		bool ProcessGone(uint64_t process);
+#endif
+	}
+
+	//pointer that stores the distance to its target relative to its own address
+	//copying one recalculates the distance, so it stays pointing at the same object wherever it is copied to
+	template <typename T>
+	class OffsetPtr
+	{
+	public:
+		//default constructor
+		OffsetPtr();
+		//constructor that takes in a pointer
+		OffsetPtr(T* ptr);
+
+		//copy constructor and copy assignment operator
+		OffsetPtr(const OffsetPtr& other);
+		OffsetPtr& operator=(const OffsetPtr& other);
+		OffsetPtr& operator=(T* ptr);
+
+		//functions that return the raw pointer
+		T* Get() const;
+		T* operator->() const;
+
+		//functions that dereferences pointer
+		T& Dereference() const;
+		T& operator*() const;
+
+	private:
+		//calculates the distance from this pointer to ptr
+		std::ptrdiff_t Distance(const T* ptr) const;
+
+	private:
+		//an offset of 1 means nullptr, a real target can never be one byte into the pointer itself
+		std::ptrdiff_t offset;
+	};
+
+	//header placed at the start of every segment
+	//it is shared by everyone that maps the segment, so everything in it is an offset from the header
+	struct SegmentHeader
+	{
+		//small blocks are kept in exact size free lists, larger ones in a single first fit list
+		static constexpr size_t Granule = 16;
+		static constexpr size_t SmallClasses = 64;
+
+		uint64_t magic;
+		uint64_t size;
+		//offset of the first byte that has never been allocated
+		uint64_t top;
+		//bytes currently handed out
+		uint64_t used;
+		//lock for the allocator, a lock free atomic is address free so it works across processes
+		//it holds the process that took it, so a lock left behind by a crash can be broken (see ShmSegment::Recover)
+		//every list update is a single store made after the block it links is ready, a process that dies inside
+		//of the lock can leak the block it was working on and leave used off, but never breaks a list
+		std::atomic<uint64_t> lock;
+		//head offsets of the free lists
+		uint64_t smallFree[SmallClasses];
+		uint64_t largeFree;
+		//offset of the object the segment was built around, 0 if there is none
+		uint64_t root;
+	};
+
+	//handle to a segment, this is a plain pointer to the header and is only valid in the process that made it
+	//like a pointer, a const handle can still change the segment it points to
+	class Segment
+	{
+	public:
+		static constexpr uint64_t Magic = 0x50747253656731ull;
+
+		//default constructor
+		Segment();
+		//constructor that takes in an already formatted header
+		explicit Segment(SegmentHeader* header);
+
+		//formats a fresh segment over size bytes of memory (Segment segment = Segment::Create(memory, size);)
+		static Segment Create(void* memory, size_t size);
+		//attaches to memory that was formatted before, returns an invalid segment if the header does not match
+		static Segment Attach(void* memory);
+
+		//returns true if the segment is usable
+		bool IsValid() const;
+
+		//allocates size bytes aligned to 16 bytes, throws std::bad_alloc once the segment is full
+		void* Allocate(size_t size) const;
+		//returns a block to the segment
+		void Deallocate(void* ptr) const;
+
+		//functions to store and look up the root object
+		template <typename T>
+		T* GetRoot() const;
+		template <typename T>
+		void SetRoot(T* root) const;
+
+		//returns true if ptr points inside of the segment
+		bool Contains(const void* ptr) const;
+
+		//functions that return information about the segment
+		SegmentHeader* GetHeader() const;
+		void* GetBase() const;
+		size_t GetSize() const;
+		size_t GetUsed() const;
+
+	private:
+		//functions to convert between addresses and offsets from the header
+		char* At(uint64_t offset) const;
+		uint64_t OffsetOf(const void* ptr) const;
+
+		//spins on the lock in the header
+		void Lock() const;
+		void Unlock() const;
+
+		//returns the value the lock is taken with, the process identifier where there is one
+		static uint64_t LockOwner();
+
+	private:
+		SegmentHeader* header;
+	};
+
+	//pointer that owns an object allocated inside of a segment
+	//both the object and the segment are stored as offsets, so the pointer can live inside the segment itself
+	template <typename T>
+	class OffsetScopedPtr
+	{
+	public:
+		//default constructor
+		OffsetScopedPtr();
+		//constructor that takes in an object that was allocated from the segment (use InitOffsetScopedPtr)
+		OffsetScopedPtr(const Segment& segment, T* ptr);
+
+		//deleted functions to avoid copying of pointers (use OffsetRefPtr)
+		OffsetScopedPtr(const OffsetScopedPtr&) = delete;
+		OffsetScopedPtr& operator=(const OffsetScopedPtr&) = delete;
+
+		//rvalue constructor and move assignment operator
+		OffsetScopedPtr(OffsetScopedPtr&& other) noexcept;
+		OffsetScopedPtr& operator=(OffsetScopedPtr&& other) noexcept;
+
+		//destructor
+		~OffsetScopedPtr();
+
+		//functions that return the raw pointer
+		T* Get() const;
+		T* operator->() const;
+
+		//functions that dereferences pointer
+		T& Dereference() const;
+		T& operator*() const;
+
+	private:
+		//function for cleanup
+		void Clean();
+
+	private:
+		OffsetPtr<T> ptr;
+		OffsetPtr<SegmentHeader> segment;
+	};
+
+	namespace detail
+	{
+		//the count and the object of an OffsetRefPtr share one block in the segment
+		template <typename T>
+		struct OffsetRefBlock
+		{
+			alignas(T) unsigned char storage[sizeof(T)];
+			size_t refs;
+
+			T* Object() { return std::launder(reinterpret_cast<T*>(storage)); }
+		};
+	}
+
+	//reference counted pointer to an object allocated inside of a segment
+	template <typename T>
+	class OffsetRefPtr
+	{
+	public:
+		//default constructor
+		OffsetRefPtr();
+
+		//copy constructor and copy assignment operator
+		OffsetRefPtr(const OffsetRefPtr& other);
+		OffsetRefPtr& operator=(const OffsetRefPtr& other);
+
+		//rvalue constructor and move assignment operator
+		OffsetRefPtr(OffsetRefPtr&& other) noexcept;
+		OffsetRefPtr& operator=(OffsetRefPtr&& other) noexcept;
+
+		//destructor
+		~OffsetRefPtr();
+
+		//functions that return the raw pointer
+		T* Get() const;
+		T* operator->() const;
+
+		//functions that dereferences pointer
+		T& Dereference() const;
+		T& operator*() const;
+
+		//returns the amount of pointers to a memory address
+		size_t GetRefCount() const;
+
+	private:
+		using Block = detail::OffsetRefBlock<T>;
+
+		template <typename U, typename ... Args>
+		friend OffsetRefPtr<U> InitOffsetRefPtr(const Segment& segment, Args&& ... mArgs);
+
+		//takes ownership of a block that already has a count of 1
+		OffsetRefPtr(const Segment& segment, Block* block);
+
+		//function for cleanup
+		void Clean();
+
+	private:
+		OffsetPtr<Block> block;
+		OffsetPtr<SegmentHeader> segment;
+	};
+
+	//calls constructor for an object inside of a segment (OffsetScopedPtr<T> ptr = InitOffsetScopedPtr<T>(segment, parameters);)
+	template <typename T, typename ... Args>
+	OffsetScopedPtr<T> InitOffsetScopedPtr(const Segment& segment, Args&& ... mArgs)
+	{
+		static_assert(alignof(T) <= SegmentHeader::Granule, "type is over aligned for a segment");
+
+		void* memory = segment.Allocate(sizeof(T));
+		try
+		{
+			return OffsetScopedPtr<T>(segment, new (memory) T(std::forward<Args>(mArgs)...));
+		}
+		catch (...)
+		{
+			segment.Deallocate(memory);
+			throw;
+		}
+	}
+
+	//calls constructor for an object inside of a segment (OffsetRefPtr<T> ptr = InitOffsetRefPtr<T>(segment, parameters);)
+	//the object and its count are allocated together
+	template <typename T, typename ... Args>
+	OffsetRefPtr<T> InitOffsetRefPtr(const Segment& segment, Args&& ... mArgs)
+	{
+		using Block = detail::OffsetRefBlock<T>;
+		static_assert(alignof(Block) <= SegmentHeader::Granule, "type is over aligned for a segment");
+
+		Block* block = static_cast<Block*>(segment.Allocate(sizeof(Block)));
+		try
+		{
+			new (block->storage) T(std::forward<Args>(mArgs)...);
+		}
+		catch (...)
+		{
+			segment.Deallocate(block);
+			throw;
+		}
+
+		block->refs = 1;
+		return OffsetRefPtr<T>(segment, block);
+	}
+
+#ifdef PTR_HAS_MMAP
+	//owns a mapping of a file and the segment inside of it
+	//the mapping is shared, so changes go back to the file and are seen by everyone else that maps it
+	class MappedSegment
+	{
+	public:
+		//default constructor
+		MappedSegment();
+
+		//opens or creates a file of size bytes and maps it (MappedSegment file = MappedSegment::OpenFile("index.bin", size);)
+		//a new file is formatted as a segment, an existing one is attached to
+		//returns an invalid mapping if the file could not be opened or does not hold a segment
+		static MappedSegment OpenFile(const char* path, size_t size);
+
+		//deleted functions to avoid mapping the same memory twice
+		MappedSegment(const MappedSegment&) = delete;
+		MappedSegment& operator=(const MappedSegment&) = delete;
+
+		//rvalue constructor and move assignment operator
+		MappedSegment(MappedSegment&& other) noexcept;
+		MappedSegment& operator=(MappedSegment&& other) noexcept;
+
+		//destructor
+		~MappedSegment();
+
+		//returns true if the mapping is usable
+		bool IsValid() const;
+
+		//returns the segment inside of the mapping
+		const Segment& GetSegment() const;
+
+		//maps size bytes of an open descriptor and formats or attaches to it, always closes the descriptor
+		static MappedSegment Map(int fd, size_t size, bool create);
+
+	private:
+		//function for cleanup
+		void Clean();
+
+	private:
+		void* memory;
+		size_t size;
+		Segment segment;
+	};
+#endif
+
+	template <typename T>
+	OffsetPtr<T>::OffsetPtr()
+		: offset(1)
+	{
+	}
+
+	template <typename T>
+	OffsetPtr<T>::OffsetPtr(T* ptr)
+		: offset(Distance(ptr))
+	{
+	}
+
+	template <typename T>
+	OffsetPtr<T>::OffsetPtr(const OffsetPtr& other)
+		//the distance has to be recalculated from our own address
+		: offset(Distance(other.Get()))
+	{
+	}
+
+	template <typename T>
+	OffsetPtr<T>& OffsetPtr<T>::operator=(const OffsetPtr& other)
+	{
+		offset = Distance(other.Get());
+		return *this;
+	}
+
+	template <typename T>
+	OffsetPtr<T>& OffsetPtr<T>::operator=(T* ptr)
+	{
+		offset = Distance(ptr);
+		return *this;
+	}
+
+	template <typename T>
+	T* OffsetPtr<T>::Get() const
+	{
+		if (offset == 1)
+			return nullptr;
+
+		return reinterpret_cast<T*>(const_cast<char*>(reinterpret_cast<const char*>(this)) + offset);
+	}
+
+	template <typename T>
+	T* OffsetPtr<T>::operator->() const
+	{
+		return Get();
+	}
+
+	template <typename T>
+	T& OffsetPtr<T>::Dereference() const
+	{
+		return *Get();
+	}
+
+	template <typename T>
+	T& OffsetPtr<T>::operator*() const
+	{
+		return *Get();
+	}
+
+	template <typename T>
+	std::ptrdiff_t OffsetPtr<T>::Distance(const T* ptr) const
+	{
+		if (ptr == nullptr)
+			return 1;
+
+		return reinterpret_cast<const char*>(ptr) - reinterpret_cast<const char*>(this);
+	}
+
+	inline Segment::Segment()
+		: header(nullptr)
+	{
+	}
+
+	inline Segment::Segment(SegmentHeader* header)
+		: header(header)
+	{
+	}
+
+	inline Segment Segment::Create(void* memory, size_t size)
+	{
+		if (memory == nullptr || size < sizeof(SegmentHeader))
+			return Segment();
+
+		SegmentHeader* header = static_cast<SegmentHeader*>(memory);
+		std::memset(static_cast<void*>(header), 0, sizeof(SegmentHeader));
+		new (&header->lock) std::atomic<uint64_t>(0);
+
+		header->size = size;
+		header->top = (sizeof(SegmentHeader) + SegmentHeader::Granule - 1) & ~uint64_t(SegmentHeader::Granule - 1);
+		header->used = 0;
+
+		//write the magic last, so a half formatted segment is never attached to
+		std::atomic_thread_fence(std::memory_order_release);
+		header->magic = Magic;
+
+		return Segment(header);
+	}
+
+	inline Segment Segment::Attach(void* memory)
+	{
+		SegmentHeader* header = static_cast<SegmentHeader*>(memory);
+		if (header == nullptr || header->magic != Magic)
+			return Segment();
+
+		return Segment(header);
+	}
+
+	inline bool Segment::IsValid() const
+	{
+		return header != nullptr;
+	}
+
+	inline void* Segment::Allocate(size_t size) const
+	{
+		static_assert(std::atomic<uint64_t>::is_always_lock_free, "segments need a lock free atomic to be shared");
+
+		//every block starts with a granule that remembers its size, so freeing does not need it
+		uint64_t total = (uint64_t(size) + 2 * SegmentHeader::Granule - 1) & ~uint64_t(SegmentHeader::Granule - 1);
+		uint64_t granules = total / SegmentHeader::Granule;
+		uint64_t block = 0;
+
+		Lock();
+
+		if (granules < SegmentHeader::SmallClasses && header->smallFree[granules] != 0)
+		{
+			//pop an exact fit
+			block = header->smallFree[granules];
+			header->smallFree[granules] = *reinterpret_cast<uint64_t*>(At(block) + sizeof(uint64_t));
+		}
+		else if (granules >= SegmentHeader::SmallClasses)
+		{
+			//take the first large block that is big enough
+			uint64_t* link = &header->largeFree;
+			while (*link != 0)
+			{
+				uint64_t candidate = *link;
+				uint64_t* next = reinterpret_cast<uint64_t*>(At(candidate) + sizeof(uint64_t));
+				if (*reinterpret_cast<uint64_t*>(At(candidate)) >= total)
+				{
+					block = candidate;
+					total = *reinterpret_cast<uint64_t*>(At(candidate));
+					*link = *next;
+					break;
+				}
+
+				link = next;
+			}
+		}
+
+		if (block == 0)
+		{
+			if (header->top + total > header->size)
+			{
+				Unlock();
+				throw std::bad_alloc();
+			}
+
+			block = header->top;
+			header->top += total;
+		}
+
+		header->used += total;
+		Unlock();
+
+		*reinterpret_cast<uint64_t*>(At(block)) = total;
+		return At(block) + SegmentHeader::Granule;
+	}
+
+	inline void Segment::Deallocate(void* ptr) const
+	{
+		if (ptr == nullptr)
+			return;
+
+		uint64_t block = OffsetOf(ptr) - SegmentHeader::Granule;
+		uint64_t total = *reinterpret_cast<uint64_t*>(At(block));
+		uint64_t granules = total / SegmentHeader::Granule;
+		uint64_t* next = reinterpret_cast<uint64_t*>(At(block) + sizeof(uint64_t));
+
+		Lock();
+
+		//the link goes in the second word, the first one keeps the size of the block
+		//the fence keeps the compiler from publishing the block before its link is written
+		if (granules < SegmentHeader::SmallClasses)
+		{
+			*next = header->smallFree[granules];
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+			header->smallFree[granules] = block;
+		}
+		else
+		{
+			*next = header->largeFree;
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+			header->largeFree = block;
+		}
+
+		header->used -= total;
+		Unlock();
+	}
+
+	template <typename T>
+	T* Segment::GetRoot() const
+	{
+		return header->root != 0 ? reinterpret_cast<T*>(At(header->root)) : nullptr;
+	}
+
+	template <typename T>
+	void Segment::SetRoot(T* root) const
+	{
+		header->root = root != nullptr ? OffsetOf(root) : 0;
+	}
+
+	inline bool Segment::Contains(const void* ptr) const
+	{
+		const char* address = static_cast<const char*>(ptr);
+		const char* base = reinterpret_cast<const char*>(header);
+		return header != nullptr && address >= base && address < base + header->size;
+	}
+
+	inline SegmentHeader* Segment::GetHeader() const
+	{
+		return header;
+	}
+
+	inline void* Segment::GetBase() const
+	{
+		return header;
+	}
+
+	inline size_t Segment::GetSize() const
+	{
+		return header != nullptr ? size_t(header->size) : 0;
+	}
+
+	inline size_t Segment::GetUsed() const
+	{
+		return header != nullptr ? size_t(header->used) : 0;
+	}
+
+	inline char* Segment::At(uint64_t offset) const
+	{
+		return reinterpret_cast<char*>(header) + offset;
+	}
+
+	inline uint64_t Segment::OffsetOf(const void* ptr) const
+	{
+		return uint64_t(static_cast<const char*>(ptr) - reinterpret_cast<const char*>(header));
+	}
+
+	inline void Segment::Lock() const
+	{
+		uint64_t self = LockOwner();
+		uint64_t expected = 0;
+		unsigned spins = 0;
+		while (!header->lock.compare_exchange_weak(expected, self, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			while (header->lock.load(std::memory_order_relaxed) != 0)
+				detail::SpinWait(spins);
+
+			expected = 0;
+		}
+	}
+
+	inline void Segment::Unlock() const
+	{
+		header->lock.store(0, std::memory_order_release);
+	}
+
+	inline uint64_t Segment::LockOwner()
+	{
+#ifdef PTR_HAS_MMAP
+		return detail::CurrentProcess();
+#else
+		return 1;
+#endif
+	}
+
+	namespace detail
+	{
+		inline void SpinWait(unsigned& spins)
+		{
+			if (spins >= 64)
+			{
+				std::this_thread::yield();
+				return;
+			}
+
+			spins++;
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#elif defined(__aarch64__)
+			__asm__ __volatile__("yield");
+#endif
+		}
+
+#ifdef PTR_HAS_MMAP
+		//returns the low 32 bits of the start time of a process, or 0 where it can not be found out
+		inline uint32_t ProcessStart(int32_t pid)
+		{
+#if defined(__linux__)
+			char path[32];
+			std::snprintf(path, sizeof(path), "/proc/%d/stat", int(pid));
+
+			int fd = open(path, O_RDONLY);
+			if (fd < 0)
+				return 0;
+
+			char buffer[512];
+			ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+			close(fd);
+			if (length <= 0)
+				return 0;
+
+			buffer[length] = '\0';
+
+			//the name of the process is in parentheses and can hold spaces, the start time is the 20th field after it
+			const char* field = std::strrchr(buffer, ')');
+			if (field == nullptr)
+				return 0;
+
+			for (unsigned spaces = 0; *field != '\0' && spaces < 20; field++)
+			{
+				if (*field == ' ')
+					spaces++;
+			}
+
+			return uint32_t(std::strtoull(field, nullptr, 10));
+#else
+			(void)pid;
+			return 0;
+#endif
+		}
+
+		inline uint64_t CurrentProcess()
+		{
+			//reading the start time is slow, it is kept until the pid changes after a fork
+			static std::atomic<uint64_t> current{ 0 };
+
+			int32_t pid = int32_t(getpid());
+			uint64_t process = current.load(std::memory_order_relaxed);
+			if (process == 0 || int32_t(uint32_t(process)) != pid)
+			{
+				process = (uint64_t(ProcessStart(pid)) << 32) | uint32_t(pid);
+				current.store(process, std::memory_order_relaxed);
+			}
+
+			return process;
+		}
+
+		inline bool ProcessGone(uint64_t process)
+		{
+			int32_t pid = int32_t(uint32_t(process));
+			if (kill(pid, 0) != 0 && errno == ESRCH)
+				return true;
+
+			//the pid is in use, but by a different process if it started at another time
+			uint32_t start = uint32_t(process >> 32);
+			uint32_t now = start != 0 ? ProcessStart(pid) : 0;
+			return now != 0 && now != start;
+		}
+#endif
+	}
+
+	template <typename T>
+	OffsetScopedPtr<T>::OffsetScopedPtr()
+		: ptr(), segment()
+	{
+	}
+
+	template <typename T>
+	OffsetScopedPtr<T>::OffsetScopedPtr(const Segment& segment, T* ptr)
+		: ptr(ptr), segment(segment.GetHeader())
+	{
+	}
+
+	template <typename T>
+	OffsetScopedPtr<T>::OffsetScopedPtr(OffsetScopedPtr&& other) noexcept
+		: ptr(other.ptr), segment(other.segment)
+	{
+		other.ptr = nullptr;
+		other.segment = nullptr;
+	}
+
+	template <typename T>
+	OffsetScopedPtr<T>& OffsetScopedPtr<T>::operator=(OffsetScopedPtr&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+
+			ptr = other.ptr;
+			segment = other.segment;
+
+			other.ptr = nullptr;
+			other.segment = nullptr;
+		}
+
+		return *this;
+	}
+
+	template <typename T>
+	OffsetScopedPtr<T>::~OffsetScopedPtr()
+	{
+		Clean();
+	}
+
+	template <typename T>
+	T* OffsetScopedPtr<T>::Get() const
+	{
+		return ptr.Get();
+	}
+
+	template <typename T>
+	T* OffsetScopedPtr<T>::operator->() const
+	{
+		return ptr.Get();
+	}
+
+	template <typename T>
+	T& OffsetScopedPtr<T>::Dereference() const
+	{
+		return *ptr;
+	}
+
+	template <typename T>
+	T& OffsetScopedPtr<T>::operator*() const
+	{
+		return *ptr;
+	}
+
+	template <typename T>
+	void OffsetScopedPtr<T>::Clean()
+	{
+		//if the pointer is not pointing to nothing, destroy the object and give its block back to the segment
+		T* object = ptr.Get();
+		if (object != nullptr)
+		{
+			object->~T();
+			Segment(segment.Get()).Deallocate(object);
+			ptr = nullptr;
+		}
+	}
+
+	template <typename T>
+	OffsetRefPtr<T>::OffsetRefPtr()
+		: block(), segment()
+	{
+	}
+
+	template <typename T>
+	OffsetRefPtr<T>::OffsetRefPtr(const Segment& segment, Block* block)
+		: block(block), segment(segment.GetHeader())
+	{
+	}
+
+	template <typename T>
+	OffsetRefPtr<T>::OffsetRefPtr(const OffsetRefPtr& other)
+		: block(other.block), segment(other.segment)
+	{
+		if (block.Get() != nullptr)
+			block->refs++;
+	}
+
+	template <typename T>
+	OffsetRefPtr<T>& OffsetRefPtr<T>::operator=(const OffsetRefPtr& other)
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+
+			block = other.block;
+			segment = other.segment;
+
+			if (block.Get() != nullptr)
+				block->refs++;
+		}
+
+		return *this;
+	}
+
+	template <typename T>
+	OffsetRefPtr<T>::OffsetRefPtr(OffsetRefPtr&& other) noexcept
+		: block(other.block), segment(other.segment)
+	{
+		other.block = nullptr;
+		other.segment = nullptr;
+	}
+
+	template <typename T>
+	OffsetRefPtr<T>& OffsetRefPtr<T>::operator=(OffsetRefPtr&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+
+			block = other.block;
+			segment = other.segment;
+
+			other.block = nullptr;
+			other.segment = nullptr;
+		}
+
+		return *this;
+	}
+
+	template <typename T>
+	OffsetRefPtr<T>::~OffsetRefPtr()
+	{
+		Clean();
+	}
+
+	template <typename T>
+	T* OffsetRefPtr<T>::Get() const
+	{
+		Block* target = block.Get();
+		return target != nullptr ? target->Object() : nullptr;
+	}
+
+	template <typename T>
+	T* OffsetRefPtr<T>::operator->() const
+	{
+		return block->Object();
+	}
+
+	template <typename T>
+	T& OffsetRefPtr<T>::Dereference() const
+	{
+		return *block->Object();
+	}
+
+	template <typename T>
+	T& OffsetRefPtr<T>::operator*() const
+	{
+		return *block->Object();
+	}
+
+	template <typename T>
+	size_t OffsetRefPtr<T>::GetRefCount() const
+	{
+		Block* target = block.Get();
+		return target != nullptr ? target->refs : 0;
+	}
+
+	template <typename T>
+	void OffsetRefPtr<T>::Clean()
+	{
+		Block* target = block.Get();
+		if (target == nullptr)
+			return;
+
+		//only the last pointer destroys the object and frees the block
+		if (--target->refs == 0)
+		{
+			target->Object()->~T();
+			Segment(segment.Get()).Deallocate(target);
+		}
+
+		block = nullptr;
+	}
+
+#ifdef PTR_HAS_MMAP
+	inline MappedSegment::MappedSegment()
+		: memory(nullptr), size(0), segment()
+	{
+	}
+
+	inline MappedSegment MappedSegment::OpenFile(const char* path, size_t size)
+	{
+		int fd = open(path, O_RDWR | O_CREAT, 0644);
+		if (fd < 0)
+			return MappedSegment();
+
+		struct stat info;
+		if (fstat(fd, &info) != 0)
+		{
+			close(fd);
+			return MappedSegment();
+		}
+
+		//an empty file is new and gets formatted, anything else has to already hold a segment
+		bool create = info.st_size == 0;
+		if (create && ftruncate(fd, off_t(size)) != 0)
+		{
+			close(fd);
+			return MappedSegment();
+		}
+
+		return Map(fd, create ? size : size_t(info.st_size), create);
+	}
+
+	inline MappedSegment MappedSegment::Map(int fd, size_t size, bool create)
+	{
+		void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (memory == MAP_FAILED)
+			return MappedSegment();
+
+		Segment segment = create ? Segment::Create(memory, size) : Segment::Attach(memory);
+		if (!segment.IsValid())
+		{
+			munmap(memory, size);
+			return MappedSegment();
+		}
+
+		MappedSegment mapping;
+		mapping.memory = memory;
+		mapping.size = size;
+		mapping.segment = segment;
+		return mapping;
+	}
+
+	inline MappedSegment::MappedSegment(MappedSegment&& other) noexcept
+		: memory(other.memory), size(other.size), segment(other.segment)
+	{
+		other.memory = nullptr;
+		other.size = 0;
+		other.segment = Segment();
+	}
+
+	inline MappedSegment& MappedSegment::operator=(MappedSegment&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+
+			memory = other.memory;
+			size = other.size;
+			segment = other.segment;
+
+			other.memory = nullptr;
+			other.size = 0;
+			other.segment = Segment();
+		}
+
+		return *this;
+	}
+
+	inline MappedSegment::~MappedSegment()
+	{
+		Clean();
+	}
+
+	inline bool MappedSegment::IsValid() const
+	{
+		return memory != nullptr;
+	}
+
+	inline const Segment& MappedSegment::GetSegment() const
+	{
+		return segment;
+	}
+
+	inline void MappedSegment::Clean()
+	{
+		if (memory != nullptr)
+			munmap(memory, size);
+
+		memory = nullptr;
+		size = 0;
+		segment = Segment();
+	}
+#endif
+}
+
+#endif
@@ -24,18 +24,388 @@
 * Licensced under the MIT License
 */
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//objects and blocks made by the library come from the caching allocator when this is defined (see CachingAllocator.h)
+#ifdef PTR_CACHING_ALLOCATOR
+#include "CachingAllocator.h"
+#endif
+
+//views register themselves, and destroying an object that a view still refers to stops the program (see RefView.h)
+//meant for debug builds, it takes a lock for every view that is made or destroyed
+#ifdef PTR_DEBUG_VIEWS
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#endif
+
+//both of the above change how the library makes and destroys objects, so they have to be set the same way for the whole
+//program (on the compiler command line), an object made by one file can be destroyed by another
+//the msvc linker reports files that disagree, other toolchains do not check it
+#if defined(_MSC_VER)
+#ifdef PTR_CACHING_ALLOCATOR
+#pragma detect_mismatch("PTR_CACHING_ALLOCATOR", "1")
+#else
+#pragma detect_mismatch("PTR_CACHING_ALLOCATOR", "0")
+#endif
+#ifdef PTR_DEBUG_VIEWS
+#pragma detect_mismatch("PTR_DEBUG_VIEWS", "1")
+#else
+#pragma detect_mismatch("PTR_DEBUG_VIEWS", "0")
+#endif
+#endif
+
+//ScopedPtr can be used in constant expressions when the compiler allows new and delete in them (C++20)
+//memory allocated during constant evaluation has to be freed before it ends, it cannot be kept in a constexpr variable
+#if defined(__cpp_constexpr_dynamic_alloc) && __cpp_constexpr_dynamic_alloc >= 201907L
+#define PTR_CONSTEXPR20 constexpr
+#else
+#define PTR_CONSTEXPR20
+#endif
+
+//ScopedPtr and RefPtr are passed in registers where the compiler supports it (clang)
+//the object that was passed in is then destroyed by the function it was passed to, not by the caller
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(clang::trivial_abi)
+#define PTR_TRIVIAL_ABI [[clang::trivial_abi]]
+#endif
+#endif
+
+#ifndef PTR_TRIVIAL_ABI
+#define PTR_TRIVIAL_ABI
+#endif
+
+//makes sure static pointers are set up at compile time, before any code runs (C++20)
+//without it they still are as long as they are initialized with constants (see StaticRefBlock)
+#if defined(__cpp_constinit)
+#define PTR_CONSTINIT constinit
+#else
+#define PTR_CONSTINIT
+#endif
+
+//hints that memory at address is about to be read, so it can be loaded into the cache ahead of time
+#if defined(__GNUC__) || defined(__clang__)
+#define PTR_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PTR_PREFETCH(address) ((void)(address))
+#endif
+
 namespace Ptr
 {
+	//counter that is not thread safe, UInt is the type of the count
+	//a narrower count makes the block smaller, a count that would overflow it becomes immortal instead of wrapping around
+	template <typename UInt>
+	struct BasicRefCounter
+	{
+		static_assert(std::is_unsigned<UInt>::value && sizeof(UInt) <= sizeof(size_t), "the count has to be an unsigned integer no wider than size_t");
+
+		using Type = UInt;
+
+		//counts with the top bit set are immortal, they are never written again and their object is never freed
+		//an immortal count starts halfway into that range, so updates that race with making it immortal keep it there
+		static constexpr UInt ImmortalBit = UInt(~(UInt(~UInt(0)) >> 1));
+		static constexpr UInt ImmortalCount = UInt(ImmortalBit | (ImmortalBit >> 1));
+
+		static bool IsImmortal(size_t count) { return (count & ImmortalBit) != 0; }
+
+		//amount is more than 1 for bulk operations (see BulkRef.h)
+		static void Increment(Type& count, size_t amount = 1)
+		{
+			if (IsImmortal(count))
+				return;
+
+			//a count that would run into the immortal range stays there
+			count = amount < size_t(ImmortalBit - count) ? UInt(count + amount) : ImmortalCount;
+		}
+		//returns the count after the decrement
+		static size_t Decrement(Type& count, size_t amount = 1) { return IsImmortal(count) ? count : count = UInt(count - amount); }
+		static size_t Load(const Type& count) { return count; }
+		//increases the count unless it already reached 0, returns false if it did
+		static bool IncrementIfNotZero(Type& count) { return count != 0 ? (Increment(count), true) : false; }
+		static void MakeImmortal(Type& count) { count = ImmortalCount; }
+	};
+
+	//thread safe counter, UInt is the type of the count
+	//the last release synchronizes with every earlier one, so the object is only deleted once everyone is done with it
+	template <typename UInt>
+	struct BasicAtomicRefCounter
+	{
+		using Type = std::atomic<UInt>;
+
+		static constexpr UInt ImmortalBit = BasicRefCounter<UInt>::ImmortalBit;
+		static constexpr UInt ImmortalCount = BasicRefCounter<UInt>::ImmortalCount;
+
+		static bool IsImmortal(size_t count) { return BasicRefCounter<UInt>::IsImmortal(count); }
+
+		//immortal counts are only read, so the cache line of a shared object is not written back and forth between cores
+		static void Increment(Type& count, size_t amount = 1)
+		{
+			if (IsImmortal(count.load(std::memory_order_relaxed)))
+				return;
+
+			if (amount >= ImmortalBit)
+			{
+				MakeImmortal(count);
+				return;
+			}
+
+			//a count that ran into the immortal range is moved to the middle of it, so decrements in flight can not bring it back
+			UInt previous = count.fetch_add(UInt(amount), std::memory_order_relaxed);
+			if (IsImmortal(previous) || IsImmortal(UInt(previous + amount)))
+				MakeImmortal(count);
+		}
+		static size_t Decrement(Type& count, size_t amount = 1)
+		{
+			if (IsImmortal(count.load(std::memory_order_relaxed)))
+				return ImmortalCount;
+
+			return UInt(count.fetch_sub(UInt(amount), std::memory_order_acq_rel) - amount);
+		}
+		static size_t Load(const Type& count) { return count.load(std::memory_order_acquire); }
+		static bool IncrementIfNotZero(Type& count)
+		{
+			UInt current = count.load(std::memory_order_relaxed);
+			while (current != 0)
+			{
+				if (IsImmortal(current))
+					return true;
+
+				if (current == ImmortalBit - 1)
+				{
+					MakeImmortal(count);
+					return true;
+				}
+
+				if (count.compare_exchange_weak(current, UInt(current + 1), std::memory_order_relaxed))
+					return true;
+			}
+
+			return false;
+		}
+		static void MakeImmortal(Type& count) { count.store(ImmortalCount, std::memory_order_relaxed); }
+	};
+
+	//counter used by RefPtr by default, it is not thread safe
+	using RefCounter = BasicRefCounter<size_t>;
+
+	//thread safe counter (RefPtr<T, AtomicRefCounter> or AtomicRefPtr<T>)
+	using AtomicRefCounter = BasicAtomicRefCounter<size_t>;
+
+	//counters with a 32 bit count, for blocks that pack the count next to other 32 bit fields
+	using RefCounter32 = BasicRefCounter<uint32_t>;
+	using AtomicRefCounter32 = BasicAtomicRefCounter<uint32_t>;
+
+	namespace detail
+	{
+		//returns true while the function is being evaluated by the compiler, in a constant expression
+		constexpr bool IsConstantEvaluated()
+		{
+#if defined(__cpp_lib_is_constant_evaluated)
+			return std::is_constant_evaluated();
+#else
+			return false;
+#endif
+		}
+
+#ifdef PTR_CACHING_ALLOCATOR
+		//types with their own operator new keep using it (see SlabAllocator.h)
+		template <typename T, typename = void>
+		struct HasClassNew : std::false_type {};
+
+		template <typename T>
+		struct HasClassNew<T, std::void_t<decltype(T::operator new(size_t()))>> : std::true_type {};
+
+		template <typename T>
+		struct UsesCachingAllocator : std::integral_constant<bool, sizeof(T) <= CachingAllocator::MaxSize && alignof(T) <= CachingAllocator::Alignment && !HasClassNew<T>::value> {};
+
+		//returns the address an object of a derived type starts at
+		template <typename T>
+		void* StartOf(T* ptr)
+		{
+			if constexpr (std::is_polymorphic<T>::value)
+				return const_cast<void*>(dynamic_cast<const volatile void*>(ptr));
+			else
+				return const_cast<void*>(static_cast<const volatile void*>(ptr));
+		}
+#endif
+
+		//creates the objects and blocks of the library, with new or the caching allocator when it is enabled
+		template <typename T, typename ... Args>
+		PTR_CONSTEXPR20 T* NewObject(Args&& ... mArgs)
+		{
+#ifdef PTR_CACHING_ALLOCATOR
+			if constexpr (UsesCachingAllocator<T>::value)
+			{
+				void* storage = IsConstantEvaluated() ? nullptr : CachingAllocator::Allocate(sizeof(T));
+				if (storage != nullptr)
+				{
+					try
+					{
+						return new (storage) T(std::forward<Args>(mArgs)...);
+					}
+					catch (...)
+					{
+						CachingAllocator::Deallocate(storage);
+						throw;
+					}
+				}
+			}
+#endif
+
+			return new T(std::forward<Args>(mArgs)...);
+		}
+
+#ifdef PTR_DEBUG_VIEWS
+		//amount of views of every object that has any
+		struct ViewRegistry
+		{
+			std::mutex lock;
+			std::unordered_map<const volatile void*, size_t> views;
+
+			//never destroyed, static pointers may still be cleaned up after it would have been
+			static ViewRegistry& Get()
+			{
+				static ViewRegistry* registry = new ViewRegistry();
+				return *registry;
+			}
+		};
+
+		inline void AddView(const volatile void* object)
+		{
+			if (object == nullptr)
+				return;
+
+			ViewRegistry& registry = ViewRegistry::Get();
+			std::lock_guard<std::mutex> guard(registry.lock);
+			registry.views[object]++;
+		}
+
+		inline void RemoveView(const volatile void* object)
+		{
+			if (object == nullptr)
+				return;
+
+			ViewRegistry& registry = ViewRegistry::Get();
+			std::lock_guard<std::mutex> guard(registry.lock);
+
+			auto found = registry.views.find(object);
+			if (found != registry.views.end() && --found->second == 0)
+				registry.views.erase(found);
+		}
+
+		//stops the program if a view still refers to the object that is being destroyed
+		inline void CheckNoViews(const volatile void* object)
+		{
+			if (object == nullptr)
+				return;
+
+			ViewRegistry& registry = ViewRegistry::Get();
+			std::lock_guard<std::mutex> guard(registry.lock);
+
+			auto found = registry.views.find(object);
+			if (found == registry.views.end())
+				return;
+
+			std::fprintf(stderr, "Ptr: object at %p destroyed while %zu RefView(s) still refer to it\n", const_cast<void*>(object), found->second);
+			std::abort();
+		}
+#endif
+
+		//destroys an object made by NewObject or new, and frees it where it came from
+		template <typename T>
+		PTR_CONSTEXPR20 void DeleteObject(T* ptr)
+		{
+#ifdef PTR_DEBUG_VIEWS
+			if (!IsConstantEvaluated())
+				CheckNoViews(ptr);
+#endif
+
+#ifdef PTR_CACHING_ALLOCATOR
+			if (!IsConstantEvaluated() && ptr != nullptr)
+			{
+				void* start = StartOf(ptr);
+				if (CachingAllocator::Owns(start))
+				{
+					ptr->~T();
+					CachingAllocator::Deallocate(start);
+					return;
+				}
+			}
+#endif
+
+			delete ptr;
+		}
+
+		//control block shared by every RefPtr to the same object
+		//the block knows how to destroy its object, so extensions can make their own kinds of blocks
+		template <typename Counter>
+		struct RefBlock
+		{
+			constexpr RefBlock(size_t count, void (*destroy)(RefBlock*))
+				: destroy(destroy), refs(typename Counter::Type(count))
+			{
+			}
+
+			//destroys the object and frees the block, called once the count reaches 0
+			void (*destroy)(RefBlock* block);
+			//the count comes last, so blocks that derive from this one can use the space after a narrow count
+			typename Counter::Type refs;
+		};
+
+		//block for an object that was allocated on its own (RefPtr<T> ptr(new T);)
+		template <typename T, typename Counter>
+		struct RefBlockPtr : RefBlock<Counter>
+		{
+			explicit RefBlockPtr(T* object)
+				: RefBlock<Counter>(1, &Destroy), object(object)
+			{
+			}
+
+			static void Destroy(RefBlock<Counter>* block)
+			{
+				RefBlockPtr* self = static_cast<RefBlockPtr*>(block);
+				DeleteObject(self->object);
+				DeleteObject(self);
+			}
+
+			T* object;
+		};
+
+		//gives extensions access to the block of a RefPtr
+		struct RefPtrAccess;
+	}
+
+	//deleter used by ScopedPtr by default
+	template <typename T>
+	struct DefaultDeleter
+	{
+		DefaultDeleter() = default;
+		//a deleter for a derived type can be used for its base, the base needs a virtual destructor
+		template <typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+		constexpr DefaultDeleter(const DefaultDeleter<U>&) {}
+
+		PTR_CONSTEXPR20 void operator()(T* ptr) const { detail::DeleteObject(ptr); }
+	};
+
 	//pointer that deallocates heap memory once it has exited the scope
 	//for safety, there can only be 1 pointer to each heap allocated block of memory
-	template <typename T>
-	class ScopedPtr
+	//the deleter decides how the memory is given back, an empty deleter takes up no space
+	template <typename T, typename Deleter = DefaultDeleter<T>>
+	class PTR_TRIVIAL_ABI ScopedPtr : private Deleter
 	{
 	public:
 		//defualt constructor
-		ScopedPtr();
+		PTR_CONSTEXPR20 ScopedPtr();
 		//constructor that takes in a pointer (ScopedPtr<T> ptr(new T);)
-		explicit ScopedPtr(T* ptr);
+		PTR_CONSTEXPR20 explicit ScopedPtr(T* ptr);
+		//constructor that takes in a pointer and the deleter to give it back with
+		PTR_CONSTEXPR20 ScopedPtr(T* ptr, const Deleter& deleter);
 
 		//deleted functions to avoid copying of pointers (use RefPtr)
 		ScopedPtr(const ScopedPtr&) = delete;
@@ -43,23 +413,37 @@ namespace Ptr
 
 		//rvalue constructor and move assignment operator (ScopedPtr<T> ptr; ptr = ScopedPtr<T>(new T);)
 		//std::move also supported (ScopedPtr<T> ptr, ptr2; ptr = std::move(ptr2)) <- calls move assignment operator
-		ScopedPtr(ScopedPtr&& other) noexcept;
-		ScopedPtr& operator=(ScopedPtr&& other) noexcept;
+		PTR_CONSTEXPR20 ScopedPtr(ScopedPtr&& other) noexcept;
+		PTR_CONSTEXPR20 ScopedPtr& operator=(ScopedPtr&& other) noexcept;
+
+		//converting constructor, takes over a pointer to a derived type (ScopedPtr<Base> ptr = InitScopedPtr<Derived>();)
+		//assigning one works as well, through this constructor and the move assignment operator
+		template <typename U, typename E, typename = typename std::enable_if<std::is_convertible<U*, T*>::value && std::is_convertible<E, Deleter>::value>::type>
+		PTR_CONSTEXPR20 ScopedPtr(ScopedPtr<U, E>&& other) noexcept;
 
 		//destructor
-		~ScopedPtr();
+		PTR_CONSTEXPR20 ~ScopedPtr();
 
 		//functions that return the raw pointer
-		T* Get() const;
-		T* operator->() const;
+		PTR_CONSTEXPR20 T* Get() const;
+		PTR_CONSTEXPR20 T* operator->() const;
 
 		//functions that dereferences pointer
-		T& Dereference() const;
-		T& operator*() const;
+		PTR_CONSTEXPR20 T& Dereference() const;
+		PTR_CONSTEXPR20 T& operator*() const;
+
+		//returns the deleter
+		PTR_CONSTEXPR20 const Deleter& GetDeleter() const;
+
+		//gives up ownership without freeing the object, and returns it
+		PTR_CONSTEXPR20 T* Release();
 
 	private:
+		template <typename U, typename E>
+		friend class ScopedPtr;
+
 		//function for cleanup
-		void Clean();
+		PTR_CONSTEXPR20 void Clean();
 
 	private:
 		T* ptr;
@@ -68,14 +452,19 @@ namespace Ptr
 	//the only difference between the reference pointer and the scoped pointer is that reference pointers
 	//allow multiple pointers to the same memory address
 	//keeps a count of the amount of pointers, and the memory gets deallocated once the count reaches 0
-	template <typename T>
-	class RefPtr
+	//the counter decides whether the count is thread safe (RefCounter or AtomicRefCounter)
+	template <typename T, typename Counter = RefCounter>
+	class PTR_TRIVIAL_ABI RefPtr
 	{
 	public:
 		//default constructor
 		RefPtr();
 		//constructor that takes in a pointer (RefPtr<T> ptr(new T);)
 		explicit RefPtr(T* ptr);
+		//constructor that takes over one reference of an existing control block, the count is not changed
+		//used by extensions that make their own blocks (see InternPool.h), and for static objects (see StaticRefBlock)
+		//objects that derive from RefCounted are always their own block, they can not be given another one
+		constexpr RefPtr(T* ptr, detail::RefBlock<Counter>* block);
 
 		//copy constructor and copy assignment operator (RefPtr<T> ptr(new T); RefPtr<T> ptr2 = ptr)
 		RefPtr(const RefPtr& other);
@@ -86,6 +475,20 @@ namespace Ptr
 		RefPtr(RefPtr&& other) noexcept;
 		RefPtr& operator=(RefPtr&& other) noexcept;
 
+		//converting constructors, share the block of a pointer to a derived type (RefPtr<Base> ptr = derived;)
+		//assigning one works as well, through these constructors and the move assignment operator
+		template <typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+		RefPtr(const RefPtr<U, Counter>& other);
+		template <typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+		RefPtr(RefPtr<U, Counter>&& other) noexcept;
+
+		//aliasing constructors, point at ptr while sharing the block of owner (RefPtr<Member> ptr(owner, &owner->member);)
+		//keeps the whole owner alive for as long as ptr is used, without allocating anything
+		template <typename U>
+		RefPtr(const RefPtr<U, Counter>& owner, T* ptr);
+		template <typename U>
+		RefPtr(RefPtr<U, Counter>&& owner, T* ptr) noexcept;
+
 		//destructor
 		~RefPtr();
 
@@ -100,26 +503,169 @@ namespace Ptr
 		//returns the amount of pointers to a memory address
 		const size_t GetRefCount() const;
 
+		//makes the object immortal: it is never freed, and copying or destroying pointers to it no longer changes the count
+		//for singletons and other objects that live until the program ends and are shared by everything
+		void MakeImmortal();
+		//returns true if the object was made immortal
+		bool IsImmortal() const;
+
 	private:
-		//function to increase and decrease the reference count
+		template <typename U, typename C>
+		friend class RefPtr;
+		friend struct detail::RefPtrAccess;
+
+		//function to increase and decrease the reference count, DecRef returns the new count
 		void IncRef();
-		void DecRef();
+		size_t DecRef();
 
 		//function for cleanup
 		void Clean();
 
 	private:
 		T* ptr;
-		size_t* refs;
+		detail::RefBlock<Counter>* block;
+	};
+
+	//reference pointer that can be shared between threads
+	template <typename T>
+	using AtomicRefPtr = RefPtr<T, AtomicRefCounter>;
+
+	namespace detail
+	{
+		//for extensions that move references around without going through the count (see MpscQueue.h and BulkRef.h)
+		struct RefPtrAccess
+		{
+			//returns the block the pointer shares
+			template <typename T, typename Counter>
+			static RefBlock<Counter>* GetBlock(const RefPtr<T, Counter>& ptr) { return ptr.block; }
+
+			//empties the pointer without decreasing the count, the caller owns its reference from then on
+			//give the reference back with the adopting constructor (RefPtr<T> ptr(object, block);)
+			template <typename T, typename Counter>
+			static RefBlock<Counter>* Detach(RefPtr<T, Counter>& ptr)
+			{
+				RefBlock<Counter>* block = ptr.block;
+				ptr.ptr = nullptr;
+				ptr.block = nullptr;
+				return block;
+			}
+		};
+	}
+
+	//control block for an object with static storage, the count is immortal from the start and the object is never freed
+	//lets a RefPtr to static data be set up at compile time, without allocating anything
+	//PTR_CONSTINIT static Ptr::StaticRefBlock<> block;
+	//PTR_CONSTINIT static Ptr::RefPtr<const Config> defaults(&defaultConfig, &block);
+	template <typename Counter = RefCounter>
+	struct StaticRefBlock : detail::RefBlock<Counter>
+	{
+		constexpr StaticRefBlock()
+			: detail::RefBlock<Counter>(Counter::ImmortalCount, &Destroy)
+		{
+		}
+
+		//the count never reaches 0, there is nothing to destroy
+		static void Destroy(detail::RefBlock<Counter>*) {}
+	};
+
+	namespace detail
+	{
+		//common base of every RefCounted, so types that are their own block can be recognized whatever their counter is
+		struct RefCountedBase {};
+
+		template <typename T>
+		struct IsRefCounted : std::is_base_of<RefCountedBase, T> {};
+	}
+
+	//base for objects that are their own control block (class Node : public Ptr::RefCounted<> {};)
+	//a RefPtr to one does not allocate a separate block, and a RefView of one can be promoted back to a RefPtr (see RefView.h)
+	//every RefPtr that owns it has to use the object as its block: make them with InitRefPtr or RefPtr(T*), with the same counter
+	//extensions that make their own blocks (batches, intern pools) do not accept these types
+	template <typename Counter = RefCounter>
+	class RefCounted : public detail::RefBlock<Counter>, private detail::RefCountedBase
+	{
+	protected:
+		//the count starts at 0, every RefPtr made from the raw pointer takes a reference
+		RefCounted()
+			: detail::RefBlock<Counter>(0, nullptr)
+		{
+		}
+
+		//a copy is a different object, with its own count
+		RefCounted(const RefCounted&)
+			: detail::RefBlock<Counter>(0, nullptr)
+		{
+		}
+
+		RefCounted& operator=(const RefCounted&) { return *this; }
+	};
+
+	namespace detail
+	{
+		//destroys an object that is its own block
+		template <typename T, typename Counter>
+		void DestroyRefCounted(RefBlock<Counter>* block)
+		{
+			DeleteObject(static_cast<T*>(static_cast<RefCounted<Counter>*>(block)));
+		}
+
+		//returns the block of a new RefPtr to ptr, which is the object itself if it is RefCounted
+		template <typename Counter, typename T>
+		RefBlock<Counter>* NewBlock(T* ptr)
+		{
+			if constexpr (IsRefCounted<T>::value)
+			{
+				static_assert(std::is_base_of<RefCounted<Counter>, T>::value, "the counter of the pointer has to be the counter the object derives RefCounted with");
+
+				using Object = typename std::remove_const<T>::type;
+				if (ptr == nullptr)
+					return nullptr;
+
+				//the object only learns how it is destroyed once it is owned
+				//a pointer to an object that is already owned just takes another reference, like a copy would
+				RefBlock<Counter>* block = const_cast<Object*>(ptr);
+				if (block->destroy == nullptr)
+					block->destroy = &DestroyRefCounted<Object, Counter>;
+
+				Counter::Increment(block->refs);
+				return block;
+			}
+			else
+			{
+				return NewObject<RefBlockPtr<T, Counter>>(ptr);
+			}
+		}
+	}
+
+	//true for types that can be moved to a new address with memcpy, leaving the old bytes behind without destroying them
+	//containers use it to grow with realloc instead of moving and destroying every element (see PtrVector.h)
+	//specialize it for your own types that only hold pointers to things outside of themselves
+	template <typename T>
+	struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {};
+
+	//neither pointer points into itself, so moving one only has to copy its bytes
+	//the asserts pin that layout down, a member added later has to be checked before they are changed
+	template <typename T, typename Deleter>
+	struct IsTriviallyRelocatable<ScopedPtr<T, Deleter>> : IsTriviallyRelocatable<Deleter>
+	{
+		static_assert(!std::is_empty<Deleter>::value || sizeof(ScopedPtr<T, Deleter>) == sizeof(T*), "ScopedPtr with an empty deleter must hold only its raw pointer");
+		static_assert(!std::is_empty<Deleter>::value || !std::is_standard_layout<Deleter>::value || std::is_standard_layout<ScopedPtr<T, Deleter>>::value, "ScopedPtr with an empty deleter must be standard layout");
+	};
+
+	template <typename T, typename Counter>
+	struct IsTriviallyRelocatable<RefPtr<T, Counter>> : std::true_type
+	{
+		static_assert(sizeof(RefPtr<T, Counter>) == sizeof(T*) + sizeof(detail::RefBlock<Counter>*), "RefPtr must hold only its two raw pointers");
+		static_assert(std::is_standard_layout<RefPtr<T, Counter>>::value, "RefPtr must be standard layout");
 	};
 
 	//calls constructor for an object (ScopedPtr<T> ptr = InitScopedPtr<T>(parameters);)
 	//for general safety so that memory is allocated here and not in your program
 	//does the same thing as calling the explicit constructor
 	template <typename T, typename ... Args>
-	ScopedPtr<T> InitScopedPtr(Args&& ... mArgs)
+	PTR_CONSTEXPR20 ScopedPtr<T> InitScopedPtr(Args&& ... mArgs)
 	{
-		return ScopedPtr<T>(new T(std::forward<Args>(mArgs)...));
+		return ScopedPtr<T>(detail::NewObject<T>(std::forward<Args>(mArgs)...));
 	}
 
 	//calls constructor for an object (RefPtr<T> ptr = InitRefPtr<T>(parameters);)
@@ -128,32 +674,100 @@ namespace Ptr
 	template <typename T, typename ... Args>
 	RefPtr<T> InitRefPtr(Args&& ... mArgs)
 	{
-		return RefPtr<T>(new T(std::forward<Args>(mArgs)...));
+		return RefPtr<T>(detail::NewObject<T>(std::forward<Args>(mArgs)...));
 	}
 
-	template <typename T>
-	ScopedPtr<T>::ScopedPtr()
-		: ptr(nullptr)
+	//calls constructor for an object (AtomicRefPtr<T> ptr = InitAtomicRefPtr<T>(parameters);)
+	template <typename T, typename ... Args>
+	AtomicRefPtr<T> InitAtomicRefPtr(Args&& ... mArgs)
 	{
+		return AtomicRefPtr<T>(detail::NewObject<T>(std::forward<Args>(mArgs)...));
 	}
 
-	template <typename T>
-	ScopedPtr<T>::ScopedPtr(T* ptr) 
-		: ptr(ptr)
+	//casts that share the block of the original pointer (RefPtr<Derived> ptr = StaticPointerCast<Derived>(base);)
+	template <typename T, typename U, typename Counter>
+	RefPtr<T, Counter> StaticPointerCast(const RefPtr<U, Counter>& ptr)
 	{
+		return RefPtr<T, Counter>(ptr, static_cast<T*>(ptr.Get()));
 	}
 
-	template <typename T>
-	ScopedPtr<T>::ScopedPtr(ScopedPtr&& other) noexcept
-		//copy the other pointer
-		: ptr(other.ptr)
+	template <typename T, typename U, typename Counter>
+	RefPtr<T, Counter> StaticPointerCast(RefPtr<U, Counter>&& ptr)
+	{
+		T* cast = static_cast<T*>(ptr.Get());
+		return RefPtr<T, Counter>(std::move(ptr), cast);
+	}
+
+	//returns an empty pointer if the object is not a T
+	template <typename T, typename U, typename Counter>
+	RefPtr<T, Counter> DynamicPointerCast(const RefPtr<U, Counter>& ptr)
+	{
+		T* cast = dynamic_cast<T*>(ptr.Get());
+		return cast != nullptr ? RefPtr<T, Counter>(ptr, cast) : RefPtr<T, Counter>();
+	}
+
+	//if the object is not a T, ptr keeps it
+	template <typename T, typename U, typename Counter>
+	RefPtr<T, Counter> DynamicPointerCast(RefPtr<U, Counter>&& ptr)
+	{
+		T* cast = dynamic_cast<T*>(ptr.Get());
+		return cast != nullptr ? RefPtr<T, Counter>(std::move(ptr), cast) : RefPtr<T, Counter>();
+	}
+
+	template <typename T, typename U, typename Counter>
+	RefPtr<T, Counter> ConstPointerCast(const RefPtr<U, Counter>& ptr)
+	{
+		return RefPtr<T, Counter>(ptr, const_cast<T*>(ptr.Get()));
+	}
+
+	//casts that move ownership of a scoped pointer (ScopedPtr<Derived> ptr = StaticPointerCast<Derived>(std::move(base));)
+	template <typename T, typename U>
+	ScopedPtr<T> StaticPointerCast(ScopedPtr<U>&& ptr)
+	{
+		return ScopedPtr<T>(static_cast<T*>(ptr.Release()));
+	}
+
+	//if the object is not a T, ptr keeps it
+	template <typename T, typename U>
+	ScopedPtr<T> DynamicPointerCast(ScopedPtr<U>&& ptr)
+	{
+		T* cast = dynamic_cast<T*>(ptr.Get());
+		if (cast == nullptr)
+			return ScopedPtr<T>();
+
+		ptr.Release();
+		return ScopedPtr<T>(cast);
+	}
+
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 ScopedPtr<T, Deleter>::ScopedPtr()
+		: Deleter(), ptr(nullptr)
+	{
+	}
+
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 ScopedPtr<T, Deleter>::ScopedPtr(T* ptr) 
+		: Deleter(), ptr(ptr)
+	{
+	}
+
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 ScopedPtr<T, Deleter>::ScopedPtr(T* ptr, const Deleter& deleter)
+		: Deleter(deleter), ptr(ptr)
+	{
+	}
+
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 ScopedPtr<T, Deleter>::ScopedPtr(ScopedPtr&& other) noexcept
+		//copy the other pointer and its deleter
+		: Deleter(std::move(static_cast<Deleter&>(other))), ptr(other.ptr)
 	{
 		//set the other pointer to point to nothing
 		other.ptr = nullptr;
 	}
 
-	template <typename T>
-	ScopedPtr<T>& ScopedPtr<T>::operator=(ScopedPtr&& other) noexcept
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 ScopedPtr<T, Deleter>& ScopedPtr<T, Deleter>::operator=(ScopedPtr&& other) noexcept
 	{
 		//if they are not the same thing
 		if (this != &other)
@@ -162,6 +776,7 @@ namespace Ptr
 			Clean();
 
 			//copy the other pointers data and set the other pointer to point to nothing
+			static_cast<Deleter&>(*this) = std::move(static_cast<Deleter&>(other));
 			ptr = other.ptr;
 			other.ptr = nullptr;
 		}
@@ -169,69 +784,99 @@ namespace Ptr
 		return *this;
 	}
 
-	template <typename T>
-	ScopedPtr<T>::~ScopedPtr()
+	template <typename T, typename Deleter>
+	template <typename U, typename E, typename>
+	PTR_CONSTEXPR20 ScopedPtr<T, Deleter>::ScopedPtr(ScopedPtr<U, E>&& other) noexcept
+		: Deleter(std::move(static_cast<E&>(other))), ptr(other.ptr)
+	{
+		other.ptr = nullptr;
+	}
+
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 ScopedPtr<T, Deleter>::~ScopedPtr()
 	{
 		Clean();
 	}
 
-	template <typename T>
-	T* ScopedPtr<T>::Get() const
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 T* ScopedPtr<T, Deleter>::Get() const
 	{
 		return ptr;
 	}
 
-	template <typename T>
-	T* ScopedPtr<T>::operator->() const
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 T* ScopedPtr<T, Deleter>::operator->() const
 	{
 		return ptr;
 	}
 
-	template <typename T>
-	T& ScopedPtr<T>::Dereference() const
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 T& ScopedPtr<T, Deleter>::Dereference() const
 	{
 		return *ptr;
 	}
 
-	template <typename T>
-	T& ScopedPtr<T>::operator*() const
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 T& ScopedPtr<T, Deleter>::operator*() const
 	{
 		return *ptr;
 	}
 
-	template <typename T>
-	void ScopedPtr<T>::Clean()
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 const Deleter& ScopedPtr<T, Deleter>::GetDeleter() const
+	{
+		return *this;
+	}
+
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 T* ScopedPtr<T, Deleter>::Release()
+	{
+		T* released = ptr;
+		ptr = nullptr;
+		return released;
+	}
+
+	template <typename T, typename Deleter>
+	PTR_CONSTEXPR20 void ScopedPtr<T, Deleter>::Clean()
 	{
 		//if the pointer is not pointing to nothing, unallocate the memory
 		if (ptr != nullptr)
-			delete ptr;
+			static_cast<Deleter&>(*this)(ptr);
+
+		ptr = nullptr;
 	}
 
-	template <typename T>
-	RefPtr<T>::RefPtr()
-		//by default, ref count is 0 since memory has not been allocated
-		: ptr(nullptr), refs(new size_t(0))
+	template <typename T, typename Counter>
+	RefPtr<T, Counter>::RefPtr()
+		//by default there is no block, since memory has not been allocated
+		: ptr(nullptr), block(nullptr)
 	{
 	}
 
-	template <typename T>
-	RefPtr<T>::RefPtr(T* ptr)
-		//set the reference count to start at 1
-		: ptr(ptr), refs(new size_t(1))
+	template <typename T, typename Counter>
+	RefPtr<T, Counter>::RefPtr(T* ptr)
+		//the block starts with a reference count of 1
+		: ptr(ptr), block(detail::NewBlock<Counter>(ptr))
 	{
 	}
 
-	template <typename T>
-	RefPtr<T>::RefPtr(const RefPtr& other)
+	template <typename T, typename Counter>
+	constexpr RefPtr<T, Counter>::RefPtr(T* ptr, detail::RefBlock<Counter>* block)
+		: ptr(ptr), block(block)
+	{
+	}
+
+	template <typename T, typename Counter>
+	RefPtr<T, Counter>::RefPtr(const RefPtr& other)
 		//copy the other pointers data
-		: ptr(other.ptr), refs(other.refs)
+		: ptr(other.ptr), block(other.block)
 	{
 		//increase the reference count since we have a new pointer
 		IncRef();
 	}
 
-	template <typename T>
-	RefPtr<T>& RefPtr<T>::operator=(const RefPtr& other)
+	template <typename T, typename Counter>
+	RefPtr<T, Counter>& RefPtr<T, Counter>::operator=(const RefPtr& other)
 	{
 		//if they are not the same thing
 		if (this != &other)
@@ -241,7 +886,7 @@ namespace Ptr
 
 			//copy the other pointers data
 			ptr = other.ptr;
-			refs = other.refs;
+			block = other.block;
 
 			//increase the reference count
 			IncRef();
@@ -253,22 +898,22 @@ namespace Ptr
 		return *this;
 	}
 
-	template <typename T>
-	RefPtr<T>::RefPtr(RefPtr&& other) noexcept
+	template <typename T, typename Counter>
+	RefPtr<T, Counter>::RefPtr(RefPtr&& other) noexcept
 		//copy the other pointers data
-		: ptr(other.ptr), refs(other.refs)
+		: ptr(other.ptr), block(other.block)
 	{
 		//set the others data to point to nothing
 		other.ptr = nullptr;
-		other.refs = nullptr;
+		other.block = nullptr;
 
 		//here we do not increase the reference count
 		//because we are taking in an rvalue, a temporary and we are essentially stealing the data
 		//it makes no sense to increase the reference count, because we are just moving pre-exisiting data into a new container
 	}
 
-	template <typename T>
-	RefPtr<T>& RefPtr<T>::operator=(RefPtr&& other) noexcept
+	template <typename T, typename Counter>
+	RefPtr<T, Counter>& RefPtr<T, Counter>::operator=(RefPtr&& other) noexcept
 	{
 		//if they are not the same thing
 		if (this != &other)
@@ -278,86 +923,138 @@ namespace Ptr
 
 			//copy the other pointers data
 			ptr = other.ptr;
-			refs = other.refs;
+			block = other.block;
 
 			//set the other data to point to nothing
 			other.ptr = nullptr;
-			other.refs = nullptr;
+			other.block = nullptr;
 		}
 		
 		return *this;
 	}
 
-	template <typename T>
-	RefPtr<T>::~RefPtr()
+	template <typename T, typename Counter>
+	template <typename U, typename>
+	RefPtr<T, Counter>::RefPtr(const RefPtr<U, Counter>& other)
+		: ptr(other.ptr), block(other.block)
+	{
+		IncRef();
+	}
+
+	template <typename T, typename Counter>
+	template <typename U, typename>
+	RefPtr<T, Counter>::RefPtr(RefPtr<U, Counter>&& other) noexcept
+		: ptr(other.ptr), block(other.block)
+	{
+		other.ptr = nullptr;
+		other.block = nullptr;
+	}
+
+	template <typename T, typename Counter>
+	template <typename U>
+	RefPtr<T, Counter>::RefPtr(const RefPtr<U, Counter>& owner, T* ptr)
+		: ptr(ptr), block(owner.block)
+	{
+		IncRef();
+	}
+
+	template <typename T, typename Counter>
+	template <typename U>
+	RefPtr<T, Counter>::RefPtr(RefPtr<U, Counter>&& owner, T* ptr) noexcept
+		: ptr(ptr), block(owner.block)
+	{
+		owner.ptr = nullptr;
+		owner.block = nullptr;
+	}
+
+	template <typename T, typename Counter>
+	RefPtr<T, Counter>::~RefPtr()
 	{
 		Clean();
 	}
 
-	template <typename T>
-	T* RefPtr<T>::Get() const
+	template <typename T, typename Counter>
+	T* RefPtr<T, Counter>::Get() const
 	{
 		return ptr;
 	}
 
-	template <typename T>
-	T* RefPtr<T>::operator->() const
+	template <typename T, typename Counter>
+	T* RefPtr<T, Counter>::operator->() const
 	{
 		return ptr;
 	}
 
-	template <typename T>
-	T& RefPtr<T>::Dereference() const
+	template <typename T, typename Counter>
+	T& RefPtr<T, Counter>::Dereference() const
 	{
 		return *ptr;
 	}
 
-	template <typename T>
-	T& RefPtr<T>::operator*() const
+	template <typename T, typename Counter>
+	T& RefPtr<T, Counter>::operator*() const
 	{
 		return *ptr;
 	}
 
-	template <typename T>
-	const size_t RefPtr<T>::GetRefCount() const
+	template <typename T, typename Counter>
+	const size_t RefPtr<T, Counter>::GetRefCount() const
 	{
-		return *refs;
+		//a pointer without a block has nothing to count
+		if (block == nullptr)
+			return 0;
+
+		return Counter::Load(block->refs);
 	}
 
-	template <typename T>
-	void RefPtr<T>::IncRef()
+	template <typename T, typename Counter>
+	void RefPtr<T, Counter>::MakeImmortal()
 	{
-		//if the memory has been allocated then increase the count
-		if (ptr == nullptr)
-			return;
+		if (block != nullptr)
+			Counter::MakeImmortal(block->refs);
+	}
 
-		(*refs)++;
+	template <typename T, typename Counter>
+	bool RefPtr<T, Counter>::IsImmortal() const
+	{
+		return block != nullptr && Counter::IsImmortal(Counter::Load(block->refs));
 	}
 
-	template <typename T>
-	void RefPtr<T>::DecRef()
+	template <typename T, typename Counter>
+	void RefPtr<T, Counter>::IncRef()
 	{
-		//if the memory has been allocated then decrease the count
-		if (ptr == nullptr)
+		//if the block has been allocated then increase the count
+		if (block == nullptr)
 			return;
 
-		(*refs)--;
+		Counter::Increment(block->refs);
 	}
 
-	template <typename T>
-	void RefPtr<T>::Clean()
+	template <typename T, typename Counter>
+	size_t RefPtr<T, Counter>::DecRef()
 	{
-		//decrease the reference count
-		DecRef();
+		//if the block has been allocated then decrease the count
+		if (block == nullptr)
+			return 0;
 
-		//if it reaches 0, only then does the memory get freed
-		if (*refs == 0)
-		{
-			if (ptr != nullptr)
-				delete ptr;
+		return Counter::Decrement(block->refs);
+	}
 
-			delete refs;
-		}
+	template <typename T, typename Counter>
+	void RefPtr<T, Counter>::Clean()
+	{
+		//a moved from or default constructed pointer has nothing to clean
+		if (block == nullptr)
+			return;
+
+		//decrease the reference count, if it reaches 0, only then does the memory get freed
+		//the result of the decrement is used rather than reading the count again, another thread may own it by then
+		//the block frees the object, it knows how the object was allocated
+		if (DecRef() == 0)
+			block->destroy(block);
+
+		ptr = nullptr;
+		block = nullptr;
 	}
 }
 
@@ -0,0 +1,298 @@
+#pragma once
+#ifndef _PTR_VECTOR_H
+#define _PTR_VECTOR_H
+
+/**
+* PtrVector
+* Growable array of pointers that moves its elements with memcpy.
+*
+* A std::vector moves every element into its new storage and then destroys the old one when it grows,
+* for a vector of RefPtr that is a copy and a Clean() per element. ScopedPtr and RefPtr do not point into themselves,
+* so PtrVector grows with realloc instead, which copies the whole array in one go (or leaves it where it is).
+* Erasing from the middle moves the rest of the array down with a single memmove.
+*
+* PtrVector only holds types that IsTriviallyRelocatable is true for, see Ptr.h.
+*
+* Usage
+* Ptr::PtrVector<Ptr::RefPtr<Texture>> textures;
+* textures.PushBack(Ptr::InitRefPtr<Texture>(parameters));
+* for (Ptr::RefPtr<Texture>& texture : textures) texture->Bind();
+*/
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "Ptr.h"
+
+namespace Ptr
+{
+	//array of pointers that grows with realloc
+	template <typename T>
+	class PtrVector
+	{
+	public:
+		static_assert(IsTriviallyRelocatable<T>::value, "PtrVector moves its elements with memcpy, T must be trivially relocatable");
+		static_assert(alignof(T) <= alignof(std::max_align_t), "PtrVector stores its elements in memory from malloc");
+
+		//default constructor
+		PtrVector();
+
+		//deleted functions, copy the elements one by one if that is what you want
+		PtrVector(const PtrVector&) = delete;
+		PtrVector& operator=(const PtrVector&) = delete;
+
+		//rvalue constructor and move assignment operator
+		PtrVector(PtrVector&& other) noexcept;
+		PtrVector& operator=(PtrVector&& other) noexcept;
+
+		//destructor
+		~PtrVector();
+
+		//adds an element to the end
+		void PushBack(const T& value);
+		void PushBack(T&& value);
+
+		//constructs an element at the end (vector.EmplaceBack(new T);)
+		template <typename ... Args>
+		T& EmplaceBack(Args&& ... mArgs);
+
+		//destroys the last element
+		void PopBack();
+
+		//destroys the element at index, and moves the elements after it down
+		void Erase(size_t index);
+
+		//functions that return an element
+		T& operator[](size_t index);
+		const T& operator[](size_t index) const;
+		T& Back();
+		const T& Back() const;
+
+		//functions that return the amount of elements, and the amount there is room for
+		size_t Size() const;
+		size_t Capacity() const;
+		bool Empty() const;
+
+		//makes room for at least capacity elements
+		void Reserve(size_t capacity);
+
+		//destroys every element, the memory is kept
+		void Clear();
+
+		//iterators
+		T* begin();
+		T* end();
+		const T* begin() const;
+		const T* end() const;
+
+	private:
+		//grows the storage to capacity, moving the elements with realloc
+		void Grow(size_t capacity);
+
+		//function for cleanup
+		void Clean();
+
+	private:
+		T* data;
+		size_t size;
+		size_t capacity;
+	};
+
+	template <typename T>
+	PtrVector<T>::PtrVector()
+		: data(nullptr), size(0), capacity(0)
+	{
+	}
+
+	template <typename T>
+	PtrVector<T>::PtrVector(PtrVector&& other) noexcept
+		: data(other.data), size(other.size), capacity(other.capacity)
+	{
+		other.data = nullptr;
+		other.size = 0;
+		other.capacity = 0;
+	}
+
+	template <typename T>
+	PtrVector<T>& PtrVector<T>::operator=(PtrVector&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+
+			data = other.data;
+			size = other.size;
+			capacity = other.capacity;
+
+			other.data = nullptr;
+			other.size = 0;
+			other.capacity = 0;
+		}
+
+		return *this;
+	}
+
+	template <typename T>
+	PtrVector<T>::~PtrVector()
+	{
+		Clean();
+	}
+
+	template <typename T>
+	void PtrVector<T>::PushBack(const T& value)
+	{
+		EmplaceBack(value);
+	}
+
+	template <typename T>
+	void PtrVector<T>::PushBack(T&& value)
+	{
+		EmplaceBack(std::move(value));
+	}
+
+	template <typename T>
+	template <typename ... Args>
+	T& PtrVector<T>::EmplaceBack(Args&& ... mArgs)
+	{
+		if (size == capacity)
+		{
+			//the arguments could be elements of this vector, so construct the new element before the storage moves
+			T value(std::forward<Args>(mArgs)...);
+			//doubling past the largest size_t leaves a capacity Grow is sure to reject
+			Grow(capacity > 0 ? (capacity > size_t(-1) / 2 ? size_t(-1) : capacity * 2) : 8);
+			return *new (data + size++) T(std::move(value));
+		}
+
+		return *new (data + size++) T(std::forward<Args>(mArgs)...);
+	}
+
+	template <typename T>
+	void PtrVector<T>::PopBack()
+	{
+		data[--size].~T();
+	}
+
+	template <typename T>
+	void PtrVector<T>::Erase(size_t index)
+	{
+		data[index].~T();
+
+		//the destroyed element is overwritten with the bytes of the ones after it, they are not destroyed
+		std::memmove(static_cast<void*>(data + index), static_cast<const void*>(data + index + 1), (size - index - 1) * sizeof(T));
+		size--;
+	}
+
+	template <typename T>
+	T& PtrVector<T>::operator[](size_t index)
+	{
+		return data[index];
+	}
+
+	template <typename T>
+	const T& PtrVector<T>::operator[](size_t index) const
+	{
+		return data[index];
+	}
+
+	template <typename T>
+	T& PtrVector<T>::Back()
+	{
+		return data[size - 1];
+	}
+
+	template <typename T>
+	const T& PtrVector<T>::Back() const
+	{
+		return data[size - 1];
+	}
+
+	template <typename T>
+	size_t PtrVector<T>::Size() const
+	{
+		return size;
+	}
+
+	template <typename T>
+	size_t PtrVector<T>::Capacity() const
+	{
+		return capacity;
+	}
+
+	template <typename T>
+	bool PtrVector<T>::Empty() const
+	{
+		return size == 0;
+	}
+
+	template <typename T>
+	void PtrVector<T>::Reserve(size_t capacity)
+	{
+		if (capacity > this->capacity)
+			Grow(capacity);
+	}
+
+	template <typename T>
+	void PtrVector<T>::Clear()
+	{
+		for (size_t i = 0; i < size; i++)
+			data[i].~T();
+
+		size = 0;
+	}
+
+	template <typename T>
+	T* PtrVector<T>::begin()
+	{
+		return data;
+	}
+
+	template <typename T>
+	T* PtrVector<T>::end()
+	{
+		return data + size;
+	}
+
+	template <typename T>
+	const T* PtrVector<T>::begin() const
+	{
+		return data;
+	}
+
+	template <typename T>
+	const T* PtrVector<T>::end() const
+	{
+		return data + size;
+	}
+
+	template <typename T>
+	void PtrVector<T>::Grow(size_t capacity)
+	{
+		//the byte count would wrap around and realloc would hand back a block that is too small
+		if (capacity > size_t(-1) / sizeof(T))
+			throw std::bad_alloc();
+
+		//realloc copies the bytes over (or extends the block in place), the elements are not moved one by one
+		void* grown = std::realloc(static_cast<void*>(data), capacity * sizeof(T));
+		if (grown == nullptr)
+			throw std::bad_alloc();
+
+		data = static_cast<T*>(grown);
+		this->capacity = capacity;
+	}
+
+	template <typename T>
+	void PtrVector<T>::Clean()
+	{
+		Clear();
+		std::free(static_cast<void*>(data));
+
+		data = nullptr;
+		capacity = 0;
+	}
+}
+
+#endif
@@ -0,0 +1,173 @@
+#pragma once
+#ifndef _REF_VIEW_H
+#define _REF_VIEW_H
+
+/**
+* RefView
+* Borrowed pointer to an object owned by a RefPtr or a ScopedPtr, for passing it to functions without touching the count.
+*
+* Passing a RefPtr by value increases and decreases the count for every call, and passing a const RefPtr&
+* makes every use go through the RefPtr first. A RefView is a single pointer that is trivially copyable,
+* so it is passed in a register and costs nothing to make or drop. It does not own anything,
+* it must not be used after the pointer it was made from has let go of the object.
+*
+* A view of an object that derives from RefCounted can be promoted back to a RefPtr, when the object has to be kept
+* beyond the call. The object is its own control block, so the view can find the count from the object alone.
+*
+* When PTR_DEBUG_VIEWS is defined every view registers itself, and destroying an object while a view of it is left
+* stops the program with a message. Views are not trivially copyable in that mode, use it for debug builds.
+* Like PTR_CACHING_ALLOCATOR it has to be defined for the whole program, pass it on the compiler command line.
+*
+* Usage
+* void Draw(Ptr::RefView<Mesh> mesh) { mesh->Draw(); } //Draw(meshRefPtr); Draw(meshScopedPtr);
+* Ptr::RefPtr<Mesh> kept = mesh.Promote(); //Mesh derives from Ptr::RefCounted<>
+*/
+
+#include <type_traits>
+
+#include "Ptr.h"
+
+namespace Ptr
+{
+	//pointer borrowed from a RefPtr or a ScopedPtr
+	template <typename T>
+	class RefView
+	{
+	public:
+		//default constructor
+		RefView();
+		//constructor that borrows a raw pointer
+		explicit RefView(T* ptr);
+
+		//constructors that borrow the object of a pointer, implicit so functions taking a view can be called with the pointer
+		template <typename U, typename Counter, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+		RefView(const RefPtr<U, Counter>& ptr);
+		template <typename U, typename Deleter, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+		RefView(const ScopedPtr<U, Deleter>& ptr);
+
+#ifdef PTR_DEBUG_VIEWS
+		//copying and destroying a view registers and unregisters it
+		RefView(const RefView& other);
+		RefView& operator=(const RefView& other);
+		~RefView();
+#endif
+
+		//functions that return the raw pointer
+		T* Get() const;
+		T* operator->() const;
+
+		//functions that dereferences pointer
+		T& Dereference() const;
+		T& operator*() const;
+
+		//returns a new RefPtr to the object, which has to derive from RefCounted<Counter>
+		//the pointer is empty if the object is not owned by a RefPtr (a ScopedPtr or the stack owns it)
+		template <typename Counter = RefCounter>
+		RefPtr<T, Counter> Promote() const;
+
+	private:
+		T* ptr;
+	};
+
+#ifndef PTR_DEBUG_VIEWS
+	static_assert(std::is_trivially_copyable<RefView<int>>::value && sizeof(RefView<int>) == sizeof(int*), "a view is a single pointer");
+#endif
+
+	template <typename T>
+	RefView<T>::RefView()
+		: ptr(nullptr)
+	{
+	}
+
+	template <typename T>
+	RefView<T>::RefView(T* ptr)
+		: ptr(ptr)
+	{
+#ifdef PTR_DEBUG_VIEWS
+		detail::AddView(ptr);
+#endif
+	}
+
+	template <typename T>
+	template <typename U, typename Counter, typename>
+	RefView<T>::RefView(const RefPtr<U, Counter>& ptr)
+		: RefView(static_cast<T*>(ptr.Get()))
+	{
+	}
+
+	template <typename T>
+	template <typename U, typename Deleter, typename>
+	RefView<T>::RefView(const ScopedPtr<U, Deleter>& ptr)
+		: RefView(static_cast<T*>(ptr.Get()))
+	{
+	}
+
+#ifdef PTR_DEBUG_VIEWS
+	template <typename T>
+	RefView<T>::RefView(const RefView& other)
+		: ptr(other.ptr)
+	{
+		detail::AddView(ptr);
+	}
+
+	template <typename T>
+	RefView<T>& RefView<T>::operator=(const RefView& other)
+	{
+		detail::AddView(other.ptr);
+		detail::RemoveView(ptr);
+		ptr = other.ptr;
+		return *this;
+	}
+
+	template <typename T>
+	RefView<T>::~RefView()
+	{
+		detail::RemoveView(ptr);
+	}
+#endif
+
+	template <typename T>
+	T* RefView<T>::Get() const
+	{
+		return ptr;
+	}
+
+	template <typename T>
+	T* RefView<T>::operator->() const
+	{
+		return ptr;
+	}
+
+	template <typename T>
+	T& RefView<T>::Dereference() const
+	{
+		return *ptr;
+	}
+
+	template <typename T>
+	T& RefView<T>::operator*() const
+	{
+		return *ptr;
+	}
+
+	template <typename T>
+	template <typename Counter>
+	RefPtr<T, Counter> RefView<T>::Promote() const
+	{
+		static_assert(std::is_base_of<RefCounted<Counter>, T>::value, "only views of objects that derive from RefCounted can be promoted");
+
+		if (ptr == nullptr)
+			return RefPtr<T, Counter>();
+
+		//the object is its own block, it has a way to destroy itself once a RefPtr took it over
+		detail::RefBlock<Counter>* block = const_cast<typename std::remove_const<T>::type*>(ptr);
+		if (block->destroy == nullptr)
+			return RefPtr<T, Counter>();
+
+		//take a new reference for the pointer
+		Counter::Increment(block->refs);
+		return RefPtr<T, Counter>(ptr, block);
+	}
+}
+
+#endif
@@ -0,0 +1,890 @@
+#pragma once
+#ifndef _SHM_PTR_H
+#define _SHM_PTR_H
+
+/**
+* ShmPtr
+* Reference counted pointers shared between processes through POSIX shared memory.
+*
+* A ShmSegment is a named shared memory segment with a Segment allocator inside of it (see OffsetPtr.h).
+* A ShmRefPtr points to an object that lives in the segment, together with a process shared count.
+* Every process that attaches to the segment gets a slot, and the shared count is a mask of the slots that hold
+* a reference. Inside of a process the handles are counted locally, so copying a ShmRefPtr never touches the
+* shared cache line, only the first and last reference in a process do.
+*
+* Recovery
+* If a process dies while it holds references, its bit stays set in every block it was using.
+* ShmSegment::Recover() finds slots whose process no longer exists, clears their bits, and destroys the objects
+* that nobody else was holding. Locks held by a process that died, including the one of the allocator, are freed too,
+* which can leak the block the allocator was working on. Processes are told apart by their pid and start time,
+* so a pid that was reused does not keep a dead process alive. Opening a segment runs a recovery pass first.
+* Objects are destroyed through a per process registry of their types, a process that never used a type
+* frees the memory of an orphaned object of that type without running its destructor.
+*
+* Handles are process local and must not be stored inside of the segment, use the root to hand an object to
+* another process. After fork() the child has to call AfterFork() before it uses any handle it inherited.
+*
+* Usage
+* Ptr::ShmSegment shm = Ptr::ShmSegment::Create("/dataset", size_t(1) << 30);
+* shm.SetRoot(Ptr::InitShmRefPtr<Dataset>(shm, parameters));
+* ... in another process
+* Ptr::ShmSegment shm = Ptr::ShmSegment::Open("/dataset");
+* Ptr::ShmRefPtr<Dataset> dataset = shm.GetRoot<Dataset>();
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "OffsetPtr.h"
+#include "Ptr.h"
+
+#ifdef PTR_HAS_MMAP
+namespace Ptr
+{
+	template <typename T>
+	class ShmRefPtr;
+
+	namespace detail
+	{
+		//shared bookkeeping stored in the segment, it is the root of the underlying Segment
+		struct ShmDirectory
+		{
+			//the last bit of a holder mask belongs to the root, the others to processes
+			static constexpr unsigned MaxProcesses = 63;
+			static constexpr uint64_t RootBit = uint64_t(1) << 63;
+			//slot of a process that does not have one
+			static constexpr unsigned NoSlot = MaxProcesses;
+
+			std::atomic<uint64_t> attached;
+			//process in each slot (see detail::CurrentProcess), 0 while the slot is being claimed
+			std::atomic<uint64_t> processes[MaxProcesses];
+			//process holding the directory, so a lock left behind by a crash can be broken
+			std::atomic<uint64_t> lock;
+			//offset of the first live block
+			uint64_t blocks;
+			//offset of the root block, 0 if there is none
+			uint64_t root;
+		};
+
+		//header in front of every object owned by a ShmRefPtr
+		struct ShmRefBlock
+		{
+			static constexpr size_t HeaderSize = 32;
+
+			//mask of the slots holding a reference, the object is destroyed when it reaches 0
+			std::atomic<uint64_t> holders;
+			//identifies the type of the object, used when the object has to be destroyed without its type
+			uint64_t type;
+			//links of the live block list, as offsets from the segment
+			uint64_t prev;
+			uint64_t next;
+
+			void* Object() { return reinterpret_cast<char*>(this) + HeaderSize; }
+		};
+
+		//count of the references a process holds to a block
+		struct ShmLocalRef
+		{
+			std::atomic<size_t> count;
+			ShmRefBlock* block;
+		};
+
+		using ShmDestroy = void (*)(void* object);
+
+		//process local state of an attached segment, it does not move when the ShmSegment handle does
+		struct ShmState
+		{
+			MappedSegment mapping;
+			ShmDirectory* directory;
+			unsigned slot = ShmDirectory::NoSlot;
+			std::mutex lock;
+			std::unordered_map<uint64_t, ShmLocalRef*> refs;
+		};
+
+		//functions to identify a type across processes
+		uint64_t ShmHashName(const char* name);
+		void ShmRegisterType(uint64_t type, ShmDestroy destroy);
+		ShmDestroy ShmFindType(uint64_t type);
+
+		template <typename T>
+		void ShmDestroyObject(void* object)
+		{
+			static_cast<T*>(object)->~T();
+		}
+
+		template <typename T>
+		uint64_t ShmTypeOf()
+		{
+			//registered once per process the first time the type is used
+			static const uint64_t type = []()
+			{
+				uint64_t hash = ShmHashName(typeid(T).name());
+				ShmRegisterType(hash, &ShmDestroyObject<T>);
+				return hash;
+			}();
+
+			return type;
+		}
+
+		//functions for the directory lock
+		void ShmLock(ShmDirectory* directory);
+		void ShmUnlock(ShmDirectory* directory);
+
+		//frees a lock that is held by a process that no longer exists
+		void ShmBreakLock(std::atomic<uint64_t>& lock);
+
+		//returns the local count for a block, adding this process as a holder when it is the first one
+		//when adopt is true the block is brand new and its bit has already been set by the caller
+		ShmLocalRef* ShmAcquire(ShmState* state, ShmRefBlock* block, bool adopt);
+		//drops one local reference, the last one in the process drops the process bit with it
+		void ShmRelease(ShmState* state, ShmLocalRef* local, ShmDestroy destroy);
+		//unlinks and destroys a block once its holder mask reached 0
+		void ShmDestroyBlock(ShmState* state, ShmRefBlock* block, ShmDestroy destroy);
+	}
+
+	//named POSIX shared memory segment that ShmRefPtr objects are allocated from
+	class ShmSegment
+	{
+	public:
+		static constexpr unsigned MaxProcesses = detail::ShmDirectory::MaxProcesses;
+		static constexpr unsigned NoSlot = detail::ShmDirectory::NoSlot;
+
+		//default constructor
+		ShmSegment();
+
+		//creates a new segment of size bytes, fails if the name is already in use (ShmSegment shm = ShmSegment::Create("/name", size);)
+		static ShmSegment Create(const char* name, size_t size);
+		//opens a segment created by another process and recovers slots left behind by dead processes
+		static ShmSegment Open(const char* name);
+		//removes the name, the memory stays around until every process has unmapped it
+		static bool Unlink(const char* name);
+
+		//deleted functions to avoid attaching twice
+		ShmSegment(const ShmSegment&) = delete;
+		ShmSegment& operator=(const ShmSegment&) = delete;
+
+		//rvalue constructor and move assignment operator
+		ShmSegment(ShmSegment&& other) noexcept;
+		ShmSegment& operator=(ShmSegment&& other) noexcept;
+
+		//destructor, every handle into the segment must be gone by now
+		~ShmSegment();
+
+		//returns true if the segment is usable
+		bool IsValid() const;
+
+		//functions to hand an object to other processes, the root holds its own reference
+		template <typename T>
+		void SetRoot(const ShmRefPtr<T>& root);
+		template <typename T>
+		ShmRefPtr<T> GetRoot();
+		void ClearRoot();
+
+		//releases the references of processes that died, returns how many objects were destroyed
+		size_t Recover();
+
+		//must be called in the child after fork() while it is still single threaded
+		//gives the child its own slot and makes it a holder of every object it inherited a handle to
+		//returns false if every slot is taken, the child then holds nothing: it has to drop the handles it inherited
+		//without using them, and making or getting new ones throws std::bad_alloc
+		bool AfterFork();
+
+		//functions that return information about the segment
+		const Segment& GetSegment() const;
+		unsigned GetSlot() const;
+
+	private:
+		template <typename U, typename ... Args>
+		friend ShmRefPtr<U> InitShmRefPtr(ShmSegment& segment, Args&& ... mArgs);
+
+		//maps a descriptor and sets up the process state
+		static ShmSegment Attach(int fd, size_t size, bool create);
+
+		//takes a free slot for this process, returns false if all of them are in use
+		bool ClaimSlot();
+
+		//function for cleanup
+		void Clean();
+
+	private:
+		ScopedPtr<detail::ShmState> state;
+	};
+
+	//reference counted pointer to an object inside of a ShmSegment
+	template <typename T>
+	class ShmRefPtr
+	{
+	public:
+		//default constructor
+		ShmRefPtr();
+
+		//copy constructor and copy assignment operator, these only touch the count of this process
+		ShmRefPtr(const ShmRefPtr& other);
+		ShmRefPtr& operator=(const ShmRefPtr& other);
+
+		//rvalue constructor and move assignment operator
+		ShmRefPtr(ShmRefPtr&& other) noexcept;
+		ShmRefPtr& operator=(ShmRefPtr&& other) noexcept;
+
+		//destructor
+		~ShmRefPtr();
+
+		//functions that return the raw pointer
+		T* Get() const;
+		T* operator->() const;
+
+		//functions that dereferences pointer
+		T& Dereference() const;
+		T& operator*() const;
+
+		//returns the amount of pointers to the object in this process
+		size_t GetRefCount() const;
+		//returns the amount of processes (and the root) holding the object
+		size_t GetProcessCount() const;
+
+	private:
+		friend class ShmSegment;
+
+		template <typename U, typename ... Args>
+		friend ShmRefPtr<U> InitShmRefPtr(ShmSegment& segment, Args&& ... mArgs);
+
+		//takes over one local reference
+		ShmRefPtr(detail::ShmState* state, detail::ShmLocalRef* local);
+
+		//function for cleanup
+		void Clean();
+
+	private:
+		detail::ShmState* state;
+		detail::ShmLocalRef* local;
+	};
+
+	//calls constructor for an object inside of a shared memory segment (ShmRefPtr<T> ptr = InitShmRefPtr<T>(segment, parameters);)
+	template <typename T, typename ... Args>
+	ShmRefPtr<T> InitShmRefPtr(ShmSegment& segment, Args&& ... mArgs)
+	{
+		//the segment aligns blocks to a granule, and the header keeps the object on one
+		static_assert(alignof(T) <= SegmentHeader::Granule && detail::ShmRefBlock::HeaderSize % SegmentHeader::Granule == 0, "type is over aligned for a shared memory segment");
+
+		detail::ShmState* state = segment.state.Get();
+		const Segment& memory = state->mapping.GetSegment();
+
+		//a process without a slot can not hold anything
+		if (state->slot == detail::ShmDirectory::NoSlot)
+			throw std::bad_alloc();
+
+		detail::ShmRefBlock* block = static_cast<detail::ShmRefBlock*>(memory.Allocate(detail::ShmRefBlock::HeaderSize + sizeof(T)));
+		try
+		{
+			new (block->Object()) T(std::forward<Args>(mArgs)...);
+		}
+		catch (...)
+		{
+			memory.Deallocate(block);
+			throw;
+		}
+
+		new (&block->holders) std::atomic<uint64_t>(uint64_t(1) << state->slot);
+		block->type = detail::ShmTypeOf<T>();
+
+		//link the block into the live list so recovery can find it
+		uint64_t offset = uint64_t(reinterpret_cast<char*>(block) - static_cast<char*>(memory.GetBase()));
+		detail::ShmLock(state->directory);
+		block->prev = 0;
+		block->next = state->directory->blocks;
+		if (block->next != 0)
+			reinterpret_cast<detail::ShmRefBlock*>(static_cast<char*>(memory.GetBase()) + block->next)->prev = offset;
+		state->directory->blocks = offset;
+		detail::ShmUnlock(state->directory);
+
+		return ShmRefPtr<T>(state, detail::ShmAcquire(state, block, true));
+	}
+
+	namespace detail
+	{
+		inline uint64_t ShmHashName(const char* name)
+		{
+			//fnv-1a
+			uint64_t hash = 14695981039346656037ull;
+			for (; *name != '\0'; name++)
+				hash = (hash ^ uint64_t(static_cast<unsigned char>(*name))) * 1099511628211ull;
+
+			return hash;
+		}
+
+		struct ShmTypes
+		{
+			std::mutex lock;
+			std::unordered_map<uint64_t, ShmDestroy> destroy;
+		};
+
+		inline ShmTypes& GetShmTypes()
+		{
+			static ShmTypes types;
+			return types;
+		}
+
+		inline void ShmRegisterType(uint64_t type, ShmDestroy destroy)
+		{
+			ShmTypes& types = GetShmTypes();
+			std::lock_guard<std::mutex> guard(types.lock);
+			types.destroy[type] = destroy;
+		}
+
+		inline ShmDestroy ShmFindType(uint64_t type)
+		{
+			ShmTypes& types = GetShmTypes();
+			std::lock_guard<std::mutex> guard(types.lock);
+
+			auto found = types.destroy.find(type);
+			return found != types.destroy.end() ? found->second : nullptr;
+		}
+
+		inline void ShmLock(ShmDirectory* directory)
+		{
+			uint64_t self = CurrentProcess();
+			uint64_t expected = 0;
+			unsigned spins = 0;
+			while (!directory->lock.compare_exchange_weak(expected, self, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				while (directory->lock.load(std::memory_order_relaxed) != 0)
+					SpinWait(spins);
+
+				expected = 0;
+			}
+		}
+
+		inline void ShmUnlock(ShmDirectory* directory)
+		{
+			directory->lock.store(0, std::memory_order_release);
+		}
+
+		inline void ShmBreakLock(std::atomic<uint64_t>& lock)
+		{
+			uint64_t owner = lock.load(std::memory_order_relaxed);
+			if (owner != 0 && ProcessGone(owner))
+				lock.compare_exchange_strong(owner, 0, std::memory_order_acquire);
+		}
+
+		inline ShmLocalRef* ShmAcquire(ShmState* state, ShmRefBlock* block, bool adopt)
+		{
+			uint64_t offset = uint64_t(reinterpret_cast<char*>(block) - static_cast<char*>(state->mapping.GetSegment().GetBase()));
+
+			std::lock_guard<std::mutex> guard(state->lock);
+
+			auto found = state->refs.find(offset);
+			if (found != state->refs.end())
+			{
+				found->second->count.fetch_add(1, std::memory_order_relaxed);
+				return found->second;
+			}
+
+			if (!adopt)
+				block->holders.fetch_or(uint64_t(1) << state->slot, std::memory_order_relaxed);
+
+			ShmLocalRef* local = new ShmLocalRef;
+			local->count.store(1, std::memory_order_relaxed);
+			local->block = block;
+			state->refs.emplace(offset, local);
+			return local;
+		}
+
+		inline void ShmRelease(ShmState* state, ShmLocalRef* local, ShmDestroy destroy)
+		{
+			//references that are not the last one are dropped without the lock
+			size_t count = local->count.load(std::memory_order_relaxed);
+			while (count > 1)
+			{
+				if (local->count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+					return;
+			}
+
+			ShmRefBlock* block = local->block;
+			uint64_t previous;
+
+			{
+				std::lock_guard<std::mutex> guard(state->lock);
+
+				//the count only reaches 0 under the lock, so another thread can not pick the entry up through the root and free it first
+				if (local->count.fetch_sub(1, std::memory_order_acq_rel) != 1)
+					return;
+
+				state->refs.erase(uint64_t(reinterpret_cast<char*>(block) - static_cast<char*>(state->mapping.GetSegment().GetBase())));
+				delete local;
+
+				//a child that did not get a slot after fork() never became a holder
+				if (state->slot == ShmDirectory::NoSlot)
+					return;
+
+				previous = block->holders.fetch_and(~(uint64_t(1) << state->slot), std::memory_order_acq_rel);
+			}
+
+			//only the holder that clears the last bit destroys the object
+			if (previous == uint64_t(1) << state->slot)
+				ShmDestroyBlock(state, block, destroy);
+		}
+
+		inline void ShmDestroyBlock(ShmState* state, ShmRefBlock* block, ShmDestroy destroy)
+		{
+			char* base = static_cast<char*>(state->mapping.GetSegment().GetBase());
+
+			ShmLock(state->directory);
+			if (block->prev != 0)
+				reinterpret_cast<ShmRefBlock*>(base + block->prev)->next = block->next;
+			else
+				state->directory->blocks = block->next;
+
+			if (block->next != 0)
+				reinterpret_cast<ShmRefBlock*>(base + block->next)->prev = block->prev;
+			ShmUnlock(state->directory);
+
+			//the destructor runs outside of the lock, it may release other shared objects
+			if (destroy == nullptr)
+				destroy = ShmFindType(block->type);
+
+			if (destroy != nullptr)
+				destroy(block->Object());
+
+			state->mapping.GetSegment().Deallocate(block);
+		}
+	}
+
+	inline ShmSegment::ShmSegment()
+		: state()
+	{
+	}
+
+	inline ShmSegment ShmSegment::Create(const char* name, size_t size)
+	{
+		int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd < 0)
+			return ShmSegment();
+
+		if (ftruncate(fd, off_t(size)) != 0)
+		{
+			close(fd);
+			shm_unlink(name);
+			return ShmSegment();
+		}
+
+		ShmSegment segment = Attach(fd, size, true);
+		if (!segment.IsValid())
+			shm_unlink(name);
+
+		return segment;
+	}
+
+	inline ShmSegment ShmSegment::Open(const char* name)
+	{
+		int fd = shm_open(name, O_RDWR, 0600);
+		if (fd < 0)
+			return ShmSegment();
+
+		struct stat info;
+		if (fstat(fd, &info) != 0)
+		{
+			close(fd);
+			return ShmSegment();
+		}
+
+		return Attach(fd, size_t(info.st_size), false);
+	}
+
+	inline bool ShmSegment::Unlink(const char* name)
+	{
+		return shm_unlink(name) == 0;
+	}
+
+	inline ShmSegment ShmSegment::Attach(int fd, size_t size, bool create)
+	{
+		ShmSegment segment;
+		segment.state = InitScopedPtr<detail::ShmState>();
+		segment.state->mapping = MappedSegment::Map(fd, size, create);
+
+		const Segment& memory = segment.state->mapping.GetSegment();
+		if (!memory.IsValid())
+			return ShmSegment();
+
+		if (create)
+		{
+			detail::ShmDirectory* directory = static_cast<detail::ShmDirectory*>(memory.Allocate(sizeof(detail::ShmDirectory)));
+			new (&directory->attached) std::atomic<uint64_t>(0);
+			for (unsigned i = 0; i < MaxProcesses; i++)
+				new (&directory->processes[i]) std::atomic<uint64_t>(0);
+			new (&directory->lock) std::atomic<uint64_t>(0);
+			directory->blocks = 0;
+			directory->root = 0;
+
+			memory.SetRoot(directory);
+		}
+
+		segment.state->directory = memory.GetRoot<detail::ShmDirectory>();
+		if (segment.state->directory == nullptr)
+			return ShmSegment();
+
+		//opening runs a recovery pass first, so slots left behind by processes that died can be claimed
+		if (!create)
+			segment.Recover();
+
+		//more processes may have died since, recover again before giving up
+		bool claimed = segment.ClaimSlot();
+		if (!claimed)
+		{
+			segment.Recover();
+			claimed = segment.ClaimSlot();
+		}
+
+		if (!claimed)
+			return ShmSegment();
+
+		return segment;
+	}
+
+	inline ShmSegment::ShmSegment(ShmSegment&& other) noexcept
+		: state(std::move(other.state))
+	{
+	}
+
+	inline ShmSegment& ShmSegment::operator=(ShmSegment&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+			state = std::move(other.state);
+		}
+
+		return *this;
+	}
+
+	inline ShmSegment::~ShmSegment()
+	{
+		Clean();
+	}
+
+	inline bool ShmSegment::IsValid() const
+	{
+		return state.Get() != nullptr;
+	}
+
+	template <typename T>
+	void ShmSegment::SetRoot(const ShmRefPtr<T>& root)
+	{
+		detail::ShmDirectory* directory = state->directory;
+		char* base = static_cast<char*>(state->mapping.GetSegment().GetBase());
+		detail::ShmRefBlock* block = root.local != nullptr ? root.local->block : nullptr;
+
+		//the root bit is set before the old root lets go, so setting the same root twice is safe
+		if (block != nullptr)
+			block->holders.fetch_or(detail::ShmDirectory::RootBit, std::memory_order_relaxed);
+
+		detail::ShmLock(directory);
+		detail::ShmRefBlock* previous = directory->root != 0 ? reinterpret_cast<detail::ShmRefBlock*>(base + directory->root) : nullptr;
+		directory->root = block != nullptr ? uint64_t(reinterpret_cast<char*>(block) - base) : 0;
+		detail::ShmUnlock(directory);
+
+		if (previous != nullptr && previous != block)
+		{
+			if (previous->holders.fetch_and(~detail::ShmDirectory::RootBit, std::memory_order_acq_rel) == detail::ShmDirectory::RootBit)
+				detail::ShmDestroyBlock(state.Get(), previous, nullptr);
+		}
+	}
+
+	template <typename T>
+	ShmRefPtr<T> ShmSegment::GetRoot()
+	{
+		detail::ShmDirectory* directory = state->directory;
+		char* base = static_cast<char*>(state->mapping.GetSegment().GetBase());
+
+		//make sure the type is known to this process, so it can destroy the object later
+		detail::ShmTypeOf<T>();
+
+		if (state->slot == detail::ShmDirectory::NoSlot)
+			throw std::bad_alloc();
+
+		//the root keeps the block alive while the lock is held, so it is safe to become a holder
+		detail::ShmLock(directory);
+		detail::ShmRefBlock* block = directory->root != 0 ? reinterpret_cast<detail::ShmRefBlock*>(base + directory->root) : nullptr;
+		detail::ShmLocalRef* local = block != nullptr ? detail::ShmAcquire(state.Get(), block, false) : nullptr;
+		detail::ShmUnlock(directory);
+
+		return ShmRefPtr<T>(state.Get(), local);
+	}
+
+	inline void ShmSegment::ClearRoot()
+	{
+		detail::ShmDirectory* directory = state->directory;
+		char* base = static_cast<char*>(state->mapping.GetSegment().GetBase());
+
+		detail::ShmLock(directory);
+		detail::ShmRefBlock* previous = directory->root != 0 ? reinterpret_cast<detail::ShmRefBlock*>(base + directory->root) : nullptr;
+		directory->root = 0;
+		detail::ShmUnlock(directory);
+
+		if (previous != nullptr)
+		{
+			if (previous->holders.fetch_and(~detail::ShmDirectory::RootBit, std::memory_order_acq_rel) == detail::ShmDirectory::RootBit)
+				detail::ShmDestroyBlock(state.Get(), previous, nullptr);
+		}
+	}
+
+	inline size_t ShmSegment::Recover()
+	{
+		detail::ShmDirectory* directory = state->directory;
+		char* base = static_cast<char*>(state->mapping.GetSegment().GetBase());
+
+		//a process that died inside of the directory lock or the allocator leaves itself behind, take the locks over from it
+		//breaking the allocator lock can leak the block the process was working on (see SegmentHeader)
+		detail::ShmBreakLock(directory->lock);
+		detail::ShmBreakLock(state->mapping.GetSegment().GetHeader()->lock);
+
+		//the slots are checked under the lock, so a process recovering at the same time can not give back a slot
+		//that was claimed again in between
+		std::vector<detail::ShmRefBlock*> orphans;
+		detail::ShmLock(directory);
+
+		//find the slots whose process is gone
+		uint64_t dead = 0;
+		uint64_t attached = directory->attached.load(std::memory_order_acquire);
+		for (unsigned i = 0; i < MaxProcesses; i++)
+		{
+			uint64_t process = directory->processes[i].load(std::memory_order_relaxed);
+			if ((attached & (uint64_t(1) << i)) != 0 && process != 0 && detail::ProcessGone(process))
+				dead |= uint64_t(1) << i;
+		}
+
+		if (dead != 0)
+		{
+			//clear the dead bits, and collect the blocks nobody else holds
+			for (uint64_t offset = directory->blocks; offset != 0;)
+			{
+				detail::ShmRefBlock* block = reinterpret_cast<detail::ShmRefBlock*>(base + offset);
+				offset = block->next;
+
+				uint64_t previous = block->holders.fetch_and(~dead, std::memory_order_acq_rel);
+				if ((previous & dead) != 0 && (previous & ~dead) == 0)
+					orphans.push_back(block);
+			}
+
+			//give the slots back
+			for (unsigned i = 0; i < MaxProcesses; i++)
+			{
+				if ((dead & (uint64_t(1) << i)) != 0)
+					directory->processes[i].store(0, std::memory_order_relaxed);
+			}
+			directory->attached.fetch_and(~dead, std::memory_order_release);
+		}
+
+		detail::ShmUnlock(directory);
+
+		for (detail::ShmRefBlock* block : orphans)
+			detail::ShmDestroyBlock(state.Get(), block, nullptr);
+
+		return orphans.size();
+	}
+
+	inline bool ShmSegment::AfterFork()
+	{
+		//the child starts out with the slot of its parent, which it must not touch
+		bool claimed = ClaimSlot();
+		if (!claimed)
+		{
+			Recover();
+			claimed = ClaimSlot();
+		}
+
+		if (!claimed)
+		{
+			state->slot = NoSlot;
+			return false;
+		}
+
+		uint64_t bit = uint64_t(1) << state->slot;
+		for (auto& entry : state->refs)
+			entry.second->block->holders.fetch_or(bit, std::memory_order_relaxed);
+
+		return true;
+	}
+
+	inline const Segment& ShmSegment::GetSegment() const
+	{
+		return state->mapping.GetSegment();
+	}
+
+	inline unsigned ShmSegment::GetSlot() const
+	{
+		return state->slot;
+	}
+
+	inline bool ShmSegment::ClaimSlot()
+	{
+		detail::ShmDirectory* directory = state->directory;
+
+		uint64_t attached = directory->attached.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			unsigned slot = 0;
+			while (slot < MaxProcesses && (attached & (uint64_t(1) << slot)) != 0)
+				slot++;
+
+			if (slot == MaxProcesses)
+				return false;
+
+			if (directory->attached.compare_exchange_weak(attached, attached | (uint64_t(1) << slot), std::memory_order_acq_rel))
+			{
+				directory->processes[slot].store(detail::CurrentProcess(), std::memory_order_release);
+				state->slot = slot;
+				return true;
+			}
+		}
+	}
+
+	inline void ShmSegment::Clean()
+	{
+		if (state.Get() == nullptr)
+			return;
+
+		//give the slot back
+		if (state->directory != nullptr && state->slot != NoSlot)
+		{
+			state->directory->processes[state->slot].store(0, std::memory_order_relaxed);
+			state->directory->attached.fetch_and(~(uint64_t(1) << state->slot), std::memory_order_release);
+		}
+
+		state = ScopedPtr<detail::ShmState>();
+	}
+
+	template <typename T>
+	ShmRefPtr<T>::ShmRefPtr()
+		: state(nullptr), local(nullptr)
+	{
+	}
+
+	template <typename T>
+	ShmRefPtr<T>::ShmRefPtr(detail::ShmState* state, detail::ShmLocalRef* local)
+		: state(state), local(local)
+	{
+	}
+
+	template <typename T>
+	ShmRefPtr<T>::ShmRefPtr(const ShmRefPtr& other)
+		: state(other.state), local(other.local)
+	{
+		if (local != nullptr)
+			local->count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template <typename T>
+	ShmRefPtr<T>& ShmRefPtr<T>::operator=(const ShmRefPtr& other)
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+
+			state = other.state;
+			local = other.local;
+
+			if (local != nullptr)
+				local->count.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		return *this;
+	}
+
+	template <typename T>
+	ShmRefPtr<T>::ShmRefPtr(ShmRefPtr&& other) noexcept
+		: state(other.state), local(other.local)
+	{
+		other.state = nullptr;
+		other.local = nullptr;
+	}
+
+	template <typename T>
+	ShmRefPtr<T>& ShmRefPtr<T>::operator=(ShmRefPtr&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clean();
+
+			state = other.state;
+			local = other.local;
+
+			other.state = nullptr;
+			other.local = nullptr;
+		}
+
+		return *this;
+	}
+
+	template <typename T>
+	ShmRefPtr<T>::~ShmRefPtr()
+	{
+		Clean();
+	}
+
+	template <typename T>
+	T* ShmRefPtr<T>::Get() const
+	{
+		return local != nullptr ? static_cast<T*>(local->block->Object()) : nullptr;
+	}
+
+	template <typename T>
+	T* ShmRefPtr<T>::operator->() const
+	{
+		return static_cast<T*>(local->block->Object());
+	}
+
+	template <typename T>
+	T& ShmRefPtr<T>::Dereference() const
+	{
+		return *static_cast<T*>(local->block->Object());
+	}
+
+	template <typename T>
+	T& ShmRefPtr<T>::operator*() const
+	{
+		return *static_cast<T*>(local->block->Object());
+	}
+
+	template <typename T>
+	size_t ShmRefPtr<T>::GetRefCount() const
+	{
+		return local != nullptr ? local->count.load(std::memory_order_relaxed) : 0;
+	}
+
+	template <typename T>
+	size_t ShmRefPtr<T>::GetProcessCount() const
+	{
+		if (local == nullptr)
+			return 0;
+
+		uint64_t holders = local->block->holders.load(std::memory_order_relaxed);
+		size_t count = 0;
+		for (; holders != 0; holders &= holders - 1)
+			count++;
+
+		return count;
+	}
+
+	template <typename T>
+	void ShmRefPtr<T>::Clean()
+	{
+		//the last handle in this process drops the process from the holders
+		if (local != nullptr)
+			detail::ShmRelease(state, local, &detail::ShmDestroyObject<T>);
+
+		state = nullptr;
+		local = nullptr;
+	}
+}
+#endif
+
+#endif
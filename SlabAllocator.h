@@ -0,0 +1,258 @@
+#pragma once
+#ifndef _SLAB_ALLOCATOR_H
+#define _SLAB_ALLOCATOR_H
+
+/**
+* SlabAllocator
+* Allocator that gives a type its own slabs of memory, with a free list threaded through the free slots.
+*
+* Putting PTR_SLAB_ALLOCATED(Type) in the public section of a class gives it a class operator new and delete that
+* take objects from SlabAllocator<Type> instead of the global heap. InitScopedPtr, InitRefPtr, and every other new and
+* delete of the type then go through the slab, Clean() included, without replacing the global operator new.
+* Slots are exactly the size of the type, and the slot freed last is the first one handed out again.
+*
+* Every thread keeps a small list of free slots, allocating and freeing only touch that list. The shared list behind
+* it is lock free, and slots move in and out of it a batch at a time. Slabs are never given back to the system.
+* Types derived from a slab allocated type that are bigger than it use the global heap.
+*
+* Usage
+* struct Packet
+* {
+*     PTR_SLAB_ALLOCATED(Packet)
+*     char data[256];
+* };
+* Ptr::ScopedPtr<Packet> packet = Ptr::InitScopedPtr<Packet>();
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <new>
+
+#include "LockFreeFreeList.h"
+#include "Ptr.h"
+
+//gives a class its own slab allocator, put it in the public section of the class
+//the placement and nothrow forms are declared too, since a class operator new hides the global ones
+//the nothrow delete only runs when a constructor throws, it has no size so it looks the memory up in the slabs
+#define PTR_SLAB_ALLOCATED(Type) \
+	static void* operator new(size_t size) { return size == sizeof(Type) ? ::Ptr::SlabAllocator<Type>::Allocate() : ::operator new(size); } \
+	static void operator delete(void* ptr, size_t size) { if (size == sizeof(Type)) ::Ptr::SlabAllocator<Type>::Deallocate(ptr); else ::operator delete(ptr); } \
+	static void* operator new(size_t, void* where) noexcept { return where; } \
+	static void operator delete(void*, void*) noexcept {} \
+	static void* operator new(size_t size, const std::nothrow_t&) noexcept { try { return Type::operator new(size); } catch (...) { return nullptr; } } \
+	static void operator delete(void* ptr, const std::nothrow_t&) noexcept { if (::Ptr::SlabAllocator<Type>::Contains(ptr)) ::Ptr::SlabAllocator<Type>::Deallocate(ptr); else ::operator delete(ptr); }
+
+namespace Ptr
+{
+	namespace detail
+	{
+		//free slot, the link is kept in the memory the object used to be in
+		struct SlabNode
+		{
+			SlabNode* next;
+		};
+	}
+
+	//allocator for objects of a single type
+	template <typename T>
+	class SlabAllocator
+	{
+	public:
+		static_assert(alignof(T) <= alignof(std::max_align_t), "SlabAllocator does not support over aligned types");
+
+		//size of a slot, big enough to hold the free list link
+		static constexpr size_t SlotSize = sizeof(T) > sizeof(detail::SlabNode) ? sizeof(T) : sizeof(detail::SlabNode);
+		//amount of slots carved out of one slab, about 64KB worth
+		static constexpr size_t SlabSlots = 65536 / SlotSize > 16 ? 65536 / SlotSize : 16;
+		//bytes at the start of a slab that link it to the others, the slots after it stay aligned
+		static constexpr size_t SlabHeader = alignof(std::max_align_t);
+		//amount of free slots a thread keeps before it gives half of them back
+		static constexpr size_t CacheSize = 64;
+
+		//returns memory for one T
+		static void* Allocate();
+		//gives back memory returned by Allocate, from any thread
+		static void Deallocate(void* ptr);
+
+		//returns true if ptr is a slot of one of the slabs, it walks every slab so it is only meant for rare paths
+		static bool Contains(const void* ptr);
+
+	private:
+		//slots shared by every thread
+		struct Shared
+		{
+			LockFreeFreeList<detail::SlabNode> free;
+			//every slab, linked through their first bytes, so the memory stays reachable for leak checkers
+			std::atomic<detail::SlabNode*> slabs{ nullptr };
+		};
+
+		//slots kept by one thread
+		struct Cache
+		{
+			~Cache();
+
+			detail::SlabNode* free = nullptr;
+			size_t count = 0;
+		};
+
+		static Shared& GetShared();
+		static Cache& GetCache();
+
+		//moves a batch of slots from the shared list into the cache, carving a new slab if there are none
+		static void Refill(Cache& cache);
+		//moves the last count slots of the cache to the shared list
+		static void Flush(Cache& cache, size_t count);
+
+	private:
+		//set once the cache of this thread is destroyed, slots freed after that go straight to the shared list
+		inline static thread_local bool cacheDestroyed = false;
+	};
+
+	template <typename T>
+	void* SlabAllocator<T>::Allocate()
+	{
+		if (cacheDestroyed)
+		{
+			detail::SlabNode* node = GetShared().free.Pop();
+			return node != nullptr ? node : ::operator new(SlotSize);
+		}
+
+		Cache& cache = GetCache();
+		if (cache.free == nullptr)
+			Refill(cache);
+
+		detail::SlabNode* node = cache.free;
+		cache.free = node->next;
+		cache.count--;
+		return node;
+	}
+
+	template <typename T>
+	void SlabAllocator<T>::Deallocate(void* ptr)
+	{
+		detail::SlabNode* node = static_cast<detail::SlabNode*>(ptr);
+
+		if (cacheDestroyed)
+		{
+			GetShared().free.Push(node);
+			return;
+		}
+
+		Cache& cache = GetCache();
+		node->next = cache.free;
+		cache.free = node;
+		cache.count++;
+
+		//once the cache is full, half of it goes back to the shared list in one batch
+		if (cache.count > CacheSize)
+			Flush(cache, CacheSize / 2);
+	}
+
+	template <typename T>
+	bool SlabAllocator<T>::Contains(const void* ptr)
+	{
+		const char* address = static_cast<const char*>(ptr);
+		for (detail::SlabNode* slab = GetShared().slabs.load(std::memory_order_acquire); slab != nullptr; slab = slab->next)
+		{
+			const char* slots = reinterpret_cast<const char*>(slab) + SlabHeader;
+			if (std::less_equal<const char*>()(slots, address) && std::less<const char*>()(address, slots + SlabSlots * SlotSize))
+				return true;
+		}
+
+		return false;
+	}
+
+	template <typename T>
+	SlabAllocator<T>::Cache::~Cache()
+	{
+		//the thread is exiting, give everything back
+		Flush(*this, count);
+		cacheDestroyed = true;
+	}
+
+	template <typename T>
+	typename SlabAllocator<T>::Shared& SlabAllocator<T>::GetShared()
+	{
+		//never destroyed, objects can still be freed while static objects are being destroyed
+		static Shared* shared = new Shared();
+		return *shared;
+	}
+
+	template <typename T>
+	typename SlabAllocator<T>::Cache& SlabAllocator<T>::GetCache()
+	{
+		static thread_local Cache cache;
+		return cache;
+	}
+
+	template <typename T>
+	void SlabAllocator<T>::Refill(Cache& cache)
+	{
+		//take half a cache worth from the shared list in one go
+		size_t count;
+		cache.free = GetShared().free.PopBatch(CacheSize / 2, count);
+		cache.count = count;
+
+		if (cache.free != nullptr)
+			return;
+
+		//the shared list is empty, carve a new slab into one list of free slots, after the link to the other slabs
+		char* slab = static_cast<char*>(::operator new(SlabHeader + SlabSlots * SlotSize));
+		detail::SlabNode* header = reinterpret_cast<detail::SlabNode*>(slab);
+
+		Shared& shared = GetShared();
+		header->next = shared.slabs.load(std::memory_order_relaxed);
+		while (!shared.slabs.compare_exchange_weak(header->next, header, std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+
+		detail::SlabNode* first = nullptr;
+		for (size_t i = SlabSlots; i > 0; i--)
+		{
+			detail::SlabNode* node = reinterpret_cast<detail::SlabNode*>(slab + SlabHeader + (i - 1) * SlotSize);
+			node->next = first;
+			first = node;
+		}
+
+		//the cache keeps the first half a cache worth, the rest goes to the shared list for the other threads
+		cache.free = first;
+		cache.count = SlabSlots;
+		Flush(cache, SlabSlots - CacheSize / 2);
+	}
+
+	template <typename T>
+	void SlabAllocator<T>::Flush(Cache& cache, size_t count)
+	{
+		if (count == 0 || cache.free == nullptr)
+			return;
+
+		//cut the last count slots off of the cache, the first ones are the hottest
+		size_t kept = cache.count > count ? cache.count - count : 0;
+		detail::SlabNode* first = cache.free;
+		detail::SlabNode* last = nullptr;
+
+		for (size_t i = 0; i < kept; i++)
+		{
+			last = first;
+			first = first->next;
+		}
+
+		if (last != nullptr)
+			last->next = nullptr;
+		else
+			cache.free = nullptr;
+
+		cache.count = kept;
+		if (first == nullptr)
+			return;
+
+		last = first;
+		while (last->next != nullptr)
+			last = last->next;
+
+		GetShared().free.PushBatch(first, last);
+	}
+}
+
+#endif
@@ -0,0 +1,375 @@
+#pragma once
+#ifndef _SLOT_MAP_H
+#define _SLOT_MAP_H
+
+/**
+* SlotMap
+* Table of objects stored next to each other, referred to by 8 byte handles that know when their object is gone.
+*
+* A Handle is the index of a slot and the generation that slot was at when the object was added.
+* Removing an object bumps the generation of its slot, so handles to it stop working even once the slot is reused,
+* instead of pointing at whatever took its place like a raw pointer would.
+* Looking up a handle is two array reads and a compare.
+*
+* The objects themselves sit in one dense array in no particular order: removing one moves the last object into
+* its place. Iterating the map walks that array, with no gaps for removed objects.
+* Pointers and references to the objects move with them, keep the handles instead.
+*
+* The map is move only, own it through a ScopedPtr to share access to it without copying the objects.
+*
+* Usage
+* Ptr::ScopedPtr<Ptr::SlotMap<Body>> bodies = Ptr::InitScopedPtr<Ptr::SlotMap<Body>>();
+* Ptr::Handle<Body> body = bodies->Emplace(parameters);
+* if (Body* found = bodies->Get(body)) found->Step();
+* for (Body& other : *bodies) other.Step();
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "Ptr.h"
+
+namespace Ptr
+{
+	//reference to an object in a SlotMap, a default constructed handle refers to nothing
+	template <typename T>
+	struct Handle
+	{
+		static constexpr uint32_t NullIndex = UINT32_MAX;
+
+		uint32_t index = NullIndex;
+		uint32_t generation = 0;
+
+		bool IsNull() const { return index == NullIndex; }
+
+		bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const Handle& other) const { return !(*this == other); }
+	};
+
+	//dense table of objects looked up by generational handles
+	template <typename T>
+	class SlotMap
+	{
+	public:
+		using Iterator = T*;
+		using ConstIterator = const T*;
+
+		//default constructor
+		SlotMap();
+
+		//deleted functions, own the map through a ScopedPtr to share it
+		SlotMap(const SlotMap&) = delete;
+		SlotMap& operator=(const SlotMap&) = delete;
+
+		//rvalue constructor and move assignment operator, handles keep working with the map they were moved to
+		SlotMap(SlotMap&& other) noexcept;
+		SlotMap& operator=(SlotMap&& other) noexcept;
+
+		//adds an object and returns its handle (Handle<T> handle = map.Emplace(parameters);)
+		template <typename ... Args>
+		Handle<T> Emplace(Args&& ... mArgs);
+		Handle<T> Insert(const T& value);
+		Handle<T> Insert(T&& value);
+
+		//removes the object of handle, returns false if it was already gone
+		//the last object is moved into its place
+		bool Remove(Handle<T> handle);
+
+		//returns the object of handle, or nullptr if it was removed
+		T* Get(Handle<T> handle);
+		const T* Get(Handle<T> handle) const;
+		bool Contains(Handle<T> handle) const;
+
+		//functions that return an object by its place in the dense array, and the handle of that object
+		T& operator[](size_t index);
+		const T& operator[](size_t index) const;
+		Handle<T> HandleAt(size_t index) const;
+
+		//functions that return the amount of objects
+		size_t Size() const;
+		bool Empty() const;
+
+		//makes room for at least capacity objects
+		void Reserve(size_t capacity);
+
+		//removes every object, every handle handed out so far stops working
+		void Clear();
+
+		//iterators over the dense array
+		Iterator begin();
+		Iterator end();
+		ConstIterator begin() const;
+		ConstIterator end() const;
+
+	private:
+		struct Slot
+		{
+			//place of the object in the dense array, or the next free slot while the slot is free
+			uint32_t index;
+			uint32_t generation;
+		};
+
+		//returns the slot a handle refers to, or nullptr if its object is gone
+		const Slot* Find(Handle<T> handle) const;
+
+		//takes a free slot for the object that was just added to the end of the dense array
+		Handle<T> Claim();
+
+		//frees a slot, handles to it stop working
+		void Free(uint32_t slot);
+
+	private:
+		//the objects, and the slot of each of them
+		std::vector<T> objects;
+		std::vector<uint32_t> owners;
+
+		std::vector<Slot> slots;
+		uint32_t freeSlots;
+	};
+
+	template <typename T>
+	SlotMap<T>::SlotMap()
+		: objects(), owners(), slots(), freeSlots(Handle<T>::NullIndex)
+	{
+	}
+
+	template <typename T>
+	SlotMap<T>::SlotMap(SlotMap&& other) noexcept
+		: objects(std::move(other.objects)), owners(std::move(other.owners)), slots(std::move(other.slots)), freeSlots(other.freeSlots)
+	{
+		other.freeSlots = Handle<T>::NullIndex;
+	}
+
+	template <typename T>
+	SlotMap<T>& SlotMap<T>::operator=(SlotMap&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			objects = std::move(other.objects);
+			owners = std::move(other.owners);
+			slots = std::move(other.slots);
+			freeSlots = other.freeSlots;
+
+			other.objects.clear();
+			other.owners.clear();
+			other.slots.clear();
+			other.freeSlots = Handle<T>::NullIndex;
+		}
+
+		return *this;
+	}
+
+	template <typename T>
+	template <typename ... Args>
+	Handle<T> SlotMap<T>::Emplace(Args&& ... mArgs)
+	{
+		//the last index is kept for null handles
+		if (objects.size() >= Handle<T>::NullIndex - 1)
+			throw std::bad_alloc();
+
+		objects.emplace_back(std::forward<Args>(mArgs)...);
+
+		try
+		{
+			return Claim();
+		}
+		catch (...)
+		{
+			objects.pop_back();
+			throw;
+		}
+	}
+
+	template <typename T>
+	Handle<T> SlotMap<T>::Insert(const T& value)
+	{
+		return Emplace(value);
+	}
+
+	template <typename T>
+	Handle<T> SlotMap<T>::Insert(T&& value)
+	{
+		return Emplace(std::move(value));
+	}
+
+	template <typename T>
+	bool SlotMap<T>::Remove(Handle<T> handle)
+	{
+		const Slot* slot = Find(handle);
+		if (slot == nullptr)
+			return false;
+
+		uint32_t index = slot->index;
+		uint32_t last = static_cast<uint32_t>(objects.size() - 1);
+
+		//fill the hole with the last object, and point its slot at its new place
+		if (index != last)
+		{
+			objects[index] = std::move(objects[last]);
+			owners[index] = owners[last];
+			slots[owners[index]].index = index;
+		}
+
+		objects.pop_back();
+		owners.pop_back();
+		Free(handle.index);
+
+		return true;
+	}
+
+	template <typename T>
+	T* SlotMap<T>::Get(Handle<T> handle)
+	{
+		const Slot* slot = Find(handle);
+		return slot != nullptr ? &objects[slot->index] : nullptr;
+	}
+
+	template <typename T>
+	const T* SlotMap<T>::Get(Handle<T> handle) const
+	{
+		const Slot* slot = Find(handle);
+		return slot != nullptr ? &objects[slot->index] : nullptr;
+	}
+
+	template <typename T>
+	bool SlotMap<T>::Contains(Handle<T> handle) const
+	{
+		return Find(handle) != nullptr;
+	}
+
+	template <typename T>
+	T& SlotMap<T>::operator[](size_t index)
+	{
+		return objects[index];
+	}
+
+	template <typename T>
+	const T& SlotMap<T>::operator[](size_t index) const
+	{
+		return objects[index];
+	}
+
+	template <typename T>
+	Handle<T> SlotMap<T>::HandleAt(size_t index) const
+	{
+		uint32_t slot = owners[index];
+		return Handle<T>{ slot, slots[slot].generation };
+	}
+
+	template <typename T>
+	size_t SlotMap<T>::Size() const
+	{
+		return objects.size();
+	}
+
+	template <typename T>
+	bool SlotMap<T>::Empty() const
+	{
+		return objects.empty();
+	}
+
+	template <typename T>
+	void SlotMap<T>::Reserve(size_t capacity)
+	{
+		objects.reserve(capacity);
+		owners.reserve(capacity);
+		slots.reserve(capacity);
+	}
+
+	template <typename T>
+	void SlotMap<T>::Clear()
+	{
+		for (uint32_t slot : owners)
+			Free(slot);
+
+		objects.clear();
+		owners.clear();
+	}
+
+	template <typename T>
+	typename SlotMap<T>::Iterator SlotMap<T>::begin()
+	{
+		return objects.data();
+	}
+
+	template <typename T>
+	typename SlotMap<T>::Iterator SlotMap<T>::end()
+	{
+		return objects.data() + objects.size();
+	}
+
+	template <typename T>
+	typename SlotMap<T>::ConstIterator SlotMap<T>::begin() const
+	{
+		return objects.data();
+	}
+
+	template <typename T>
+	typename SlotMap<T>::ConstIterator SlotMap<T>::end() const
+	{
+		return objects.data() + objects.size();
+	}
+
+	template <typename T>
+	const typename SlotMap<T>::Slot* SlotMap<T>::Find(Handle<T> handle) const
+	{
+		//a null handle is out of range as well
+		if (handle.index >= slots.size())
+			return nullptr;
+
+		//a free slot keeps the next free slot in its index, so the object at that index has to belong to the slot too
+		//otherwise a handle from another map that matches the generation of a free slot would find it
+		const Slot& slot = slots[handle.index];
+		if (slot.generation != handle.generation || slot.index >= owners.size() || owners[slot.index] != handle.index)
+			return nullptr;
+
+		return &slot;
+	}
+
+	template <typename T>
+	Handle<T> SlotMap<T>::Claim()
+	{
+		uint32_t index = static_cast<uint32_t>(objects.size() - 1);
+
+		//grow the arrays before changing anything, so a failed allocation leaves the map as it was
+		owners.push_back(Handle<T>::NullIndex);
+		if (freeSlots == Handle<T>::NullIndex)
+		{
+			try
+			{
+				slots.push_back(Slot{ index, 0 });
+			}
+			catch (...)
+			{
+				owners.pop_back();
+				throw;
+			}
+
+			owners.back() = static_cast<uint32_t>(slots.size() - 1);
+		}
+		else
+		{
+			owners.back() = freeSlots;
+			freeSlots = slots[freeSlots].index;
+			slots[owners.back()].index = index;
+		}
+
+		uint32_t slot = owners.back();
+		return Handle<T>{ slot, slots[slot].generation };
+	}
+
+	template <typename T>
+	void SlotMap<T>::Free(uint32_t slot)
+	{
+		//the new generation no longer matches any handle to the slot
+		slots[slot].generation++;
+		slots[slot].index = freeSlots;
+		freeSlots = slot;
+	}
+}
+
+#endif
@@ -0,0 +1,339 @@
+#pragma once
+#ifndef _STABLE_VECTOR_H
+#define _STABLE_VECTOR_H
+
+/**
+* StableVector
+* Owning container of polymorphic objects that are packed next to each other in large chunks.
+*
+* A std::vector<ScopedPtr<Base>> allocates every object on its own, so walking it jumps all over the heap.
+* StableVector constructs its objects one after the other in chunks of ChunkSize bytes instead, and keeps an array
+* of pointers to them in the order they were added. Iterating reads the objects in the same order they sit in memory,
+* and ForEach prefetches the objects ahead of the one being visited.
+* Objects never move, so pointers and references to them stay valid until the container is cleared.
+*
+* Objects are only destroyed by Clear() or the destructor, which free every chunk at once.
+* Storing a type derived from T needs T to have a virtual destructor.
+*
+* Usage
+* Ptr::StableVector<Shape> shapes;
+* shapes.Emplace<Circle>(parameters);
+* shapes.ForEach([](Shape& shape) { shape.Draw(); });
+*/
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Ptr.h"
+
+namespace Ptr
+{
+	namespace detail
+	{
+		//iterator over an array of pointers that dereferences straight to the object
+		template <typename T>
+		class DerefIterator
+		{
+		public:
+			explicit DerefIterator(T* const* current) : current(current) {}
+
+			T& operator*() const { return **current; }
+			T* operator->() const { return *current; }
+
+			DerefIterator& operator++() { current++; return *this; }
+			DerefIterator operator++(int) { DerefIterator copy = *this; current++; return copy; }
+
+			bool operator==(const DerefIterator& other) const { return current == other.current; }
+			bool operator!=(const DerefIterator& other) const { return current != other.current; }
+
+		private:
+			T* const* current;
+		};
+	}
+
+	//container that owns objects packed into chunks, the objects keep their address
+	template <typename T, size_t ChunkSize = 16384>
+	class StableVector
+	{
+	public:
+		using Iterator = detail::DerefIterator<T>;
+		using ConstIterator = detail::DerefIterator<const T>;
+
+		//default constructor
+		StableVector();
+
+		//deleted functions, the objects can be of any type derived from T so they can not be copied
+		StableVector(const StableVector&) = delete;
+		StableVector& operator=(const StableVector&) = delete;
+
+		//rvalue constructor and move assignment operator, the objects stay where they are
+		StableVector(StableVector&& other) noexcept;
+		StableVector& operator=(StableVector&& other) noexcept;
+
+		//destructor
+		~StableVector();
+
+		//constructs an object at the end (vector.Emplace<Derived>(parameters);)
+		template <typename U = T, typename ... Args>
+		U* Emplace(Args&& ... mArgs);
+
+		//functions that return an object
+		T& operator[](size_t index);
+		const T& operator[](size_t index) const;
+		T& Back();
+		const T& Back() const;
+
+		//functions that return the amount of objects
+		size_t Size() const;
+		bool Empty() const;
+
+		//calls function on every object in order, prefetching the ones coming up
+		template <typename Function>
+		void ForEach(Function&& function);
+		template <typename Function>
+		void ForEach(Function&& function) const;
+
+		//destroys every object and frees every chunk
+		void Clear();
+
+		//iterators
+		Iterator begin();
+		Iterator end();
+		ConstIterator begin() const;
+		ConstIterator end() const;
+
+	private:
+		//returns space for size bytes aligned to align, starting a new chunk if the current one is full
+		void* Allocate(size_t size, size_t align);
+
+		//shared by both ForEach functions, Object is T or const T
+		template <typename Object, typename Function>
+		void Visit(Function&& function) const;
+
+	private:
+		//how far ahead of the current object ForEach prefetches
+		static constexpr size_t PrefetchDistance = 8;
+
+		std::vector<T*> objects;
+		std::vector<void*> chunks;
+		char* cursor;
+		char* limit;
+	};
+
+	template <typename T, size_t ChunkSize>
+	StableVector<T, ChunkSize>::StableVector()
+		: objects(), chunks(), cursor(nullptr), limit(nullptr)
+	{
+	}
+
+	template <typename T, size_t ChunkSize>
+	StableVector<T, ChunkSize>::StableVector(StableVector&& other) noexcept
+		: objects(std::move(other.objects)), chunks(std::move(other.chunks)), cursor(other.cursor), limit(other.limit)
+	{
+		other.objects.clear();
+		other.chunks.clear();
+		other.cursor = nullptr;
+		other.limit = nullptr;
+	}
+
+	template <typename T, size_t ChunkSize>
+	StableVector<T, ChunkSize>& StableVector<T, ChunkSize>::operator=(StableVector&& other) noexcept
+	{
+		//if they are not the same thing
+		if (this != &other)
+		{
+			Clear();
+
+			objects.swap(other.objects);
+			chunks.swap(other.chunks);
+			cursor = other.cursor;
+			limit = other.limit;
+
+			other.cursor = nullptr;
+			other.limit = nullptr;
+		}
+
+		return *this;
+	}
+
+	template <typename T, size_t ChunkSize>
+	StableVector<T, ChunkSize>::~StableVector()
+	{
+		Clear();
+	}
+
+	template <typename T, size_t ChunkSize>
+	template <typename U, typename ... Args>
+	U* StableVector<T, ChunkSize>::Emplace(Args&& ... mArgs)
+	{
+		static_assert(std::is_same<T, U>::value || (std::is_base_of<T, U>::value && std::has_virtual_destructor<T>::value), "U must be T, or derive from a T with a virtual destructor");
+		static_assert(alignof(U) <= alignof(std::max_align_t), "StableVector does not support over aligned types");
+
+		//make room in the index first, so nothing can throw once the object exists
+		objects.reserve(objects.size() + 1);
+
+		void* storage = Allocate(sizeof(U), alignof(U));
+
+		U* object;
+		try
+		{
+			object = new (storage) U(std::forward<Args>(mArgs)...);
+		}
+		catch (...)
+		{
+			//give the space back if it was the last thing taken from the current chunk
+			if (cursor == static_cast<char*>(storage) + sizeof(U))
+				cursor = static_cast<char*>(storage);
+
+			throw;
+		}
+
+		objects.push_back(object);
+		return object;
+	}
+
+	template <typename T, size_t ChunkSize>
+	T& StableVector<T, ChunkSize>::operator[](size_t index)
+	{
+		return *objects[index];
+	}
+
+	template <typename T, size_t ChunkSize>
+	const T& StableVector<T, ChunkSize>::operator[](size_t index) const
+	{
+		return *objects[index];
+	}
+
+	template <typename T, size_t ChunkSize>
+	T& StableVector<T, ChunkSize>::Back()
+	{
+		return *objects.back();
+	}
+
+	template <typename T, size_t ChunkSize>
+	const T& StableVector<T, ChunkSize>::Back() const
+	{
+		return *objects.back();
+	}
+
+	template <typename T, size_t ChunkSize>
+	size_t StableVector<T, ChunkSize>::Size() const
+	{
+		return objects.size();
+	}
+
+	template <typename T, size_t ChunkSize>
+	bool StableVector<T, ChunkSize>::Empty() const
+	{
+		return objects.empty();
+	}
+
+	template <typename T, size_t ChunkSize>
+	template <typename Function>
+	void StableVector<T, ChunkSize>::ForEach(Function&& function)
+	{
+		Visit<T>(std::forward<Function>(function));
+	}
+
+	template <typename T, size_t ChunkSize>
+	template <typename Function>
+	void StableVector<T, ChunkSize>::ForEach(Function&& function) const
+	{
+		Visit<const T>(std::forward<Function>(function));
+	}
+
+	template <typename T, size_t ChunkSize>
+	template <typename Object, typename Function>
+	void StableVector<T, ChunkSize>::Visit(Function&& function) const
+	{
+		T* const* object = objects.data();
+		size_t size = objects.size();
+
+		for (size_t i = 0; i < size; i++)
+		{
+			if (i + PrefetchDistance < size)
+				PTR_PREFETCH(object[i + PrefetchDistance]);
+
+			function(static_cast<Object&>(*object[i]));
+		}
+	}
+
+	template <typename T, size_t ChunkSize>
+	void StableVector<T, ChunkSize>::Clear()
+	{
+		//destroy in reverse, the same way a vector would
+		for (size_t i = objects.size(); i > 0; i--)
+			objects[i - 1]->~T();
+
+		for (void* chunk : chunks)
+			::operator delete(chunk);
+
+		objects.clear();
+		chunks.clear();
+		cursor = nullptr;
+		limit = nullptr;
+	}
+
+	template <typename T, size_t ChunkSize>
+	typename StableVector<T, ChunkSize>::Iterator StableVector<T, ChunkSize>::begin()
+	{
+		return Iterator(objects.data());
+	}
+
+	template <typename T, size_t ChunkSize>
+	typename StableVector<T, ChunkSize>::Iterator StableVector<T, ChunkSize>::end()
+	{
+		return Iterator(objects.data() + objects.size());
+	}
+
+	template <typename T, size_t ChunkSize>
+	typename StableVector<T, ChunkSize>::ConstIterator StableVector<T, ChunkSize>::begin() const
+	{
+		return ConstIterator(objects.data());
+	}
+
+	template <typename T, size_t ChunkSize>
+	typename StableVector<T, ChunkSize>::ConstIterator StableVector<T, ChunkSize>::end() const
+	{
+		return ConstIterator(objects.data() + objects.size());
+	}
+
+	template <typename T, size_t ChunkSize>
+	void* StableVector<T, ChunkSize>::Allocate(size_t size, size_t align)
+	{
+		if (cursor != nullptr)
+		{
+			//the padding can be more than what is left of the chunk, check it before taking it out
+			size_t padding = (align - reinterpret_cast<size_t>(cursor) % align) % align;
+			size_t left = static_cast<size_t>(limit - cursor);
+			if (padding <= left && size <= left - padding)
+			{
+				char* aligned = cursor + padding;
+				cursor = aligned + size;
+				return aligned;
+			}
+		}
+
+		//objects bigger than a chunk get a chunk of their own, and the current chunk stays the one being filled
+		if (size > ChunkSize)
+		{
+			chunks.reserve(chunks.size() + 1);
+			void* chunk = ::operator new(size);
+			chunks.push_back(chunk);
+			return chunk;
+		}
+
+		chunks.reserve(chunks.size() + 1);
+		char* chunk = static_cast<char*>(::operator new(ChunkSize));
+		chunks.push_back(chunk);
+
+		cursor = chunk + size;
+		limit = chunk + ChunkSize;
+		return chunk;
+	}
+}
+
+#endif
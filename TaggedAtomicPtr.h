@@ -0,0 +1,192 @@
+#pragma once
+#ifndef _TAGGED_ATOMIC_PTR_H
+#define _TAGGED_ATOMIC_PTR_H
+
+/**
+* TaggedAtomicPtr
+* Atomic pointer with a version tag, for lock free structures that have to be safe from ABA.
+*
+* The pointer and a 16 bit tag are packed into a single 64 bit word, the pointer in the low 48 bits
+* (which is all user space addresses use on x86-64 and AArch64) and the tag in the high 16.
+* Pointers that need more bits (5 level paging, tagged memory) are not supported, debug builds check every pointer.
+* Every store, exchange and successful compare and swap bumps the tag, so a compare and swap against a value that was
+* read before the pointer was swapped out and back in again fails, even though the pointer looks the same.
+* The tag wraps after 65536 updates, a thread would have to sleep through all of them between its read and its swap.
+*
+* Ownership can move in and out through ScopedPtr: a compare and swap with a ScopedPtr releases it only if it
+* succeeds, and an exchange with a ScopedPtr hands back the previous pointer as a ScopedPtr.
+*
+* Usage
+* Ptr::TaggedAtomicPtr<Node> head;
+* Ptr::TaggedPtr<Node> expected = head.Load();
+* while (!head.CompareExchange(expected, node)) node->next = expected.ptr;
+*/
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "Ptr.h"
+
+namespace Ptr
+{
+	//pointer and tag read from a TaggedAtomicPtr
+	template <typename T>
+	struct TaggedPtr
+	{
+		T* ptr;
+		uint16_t tag;
+
+		bool operator==(const TaggedPtr& other) const { return ptr == other.ptr && tag == other.tag; }
+		bool operator!=(const TaggedPtr& other) const { return !(*this == other); }
+	};
+
+	//atomic pointer that bumps a tag on every update
+	template <typename T>
+	class TaggedAtomicPtr
+	{
+	public:
+		//default constructor
+		TaggedAtomicPtr();
+		//constructor that takes in a pointer, the tag starts at 0
+		explicit TaggedAtomicPtr(T* ptr);
+
+		//deleted functions, atomics can not be copied
+		TaggedAtomicPtr(const TaggedAtomicPtr&) = delete;
+		TaggedAtomicPtr& operator=(const TaggedAtomicPtr&) = delete;
+
+		//returns the pointer and its tag
+		TaggedPtr<T> Load(std::memory_order order = std::memory_order_seq_cst) const;
+
+		//sets the pointer and bumps the tag
+		void Store(T* ptr, std::memory_order order = std::memory_order_seq_cst);
+
+		//sets the pointer, bumps the tag, and returns what was there before
+		TaggedPtr<T> Exchange(T* ptr, std::memory_order order = std::memory_order_seq_cst);
+		//takes over desired, and gives back ownership of the previous pointer (ScopedPtr<T> old = slot.Exchange(std::move(ptr));)
+		ScopedPtr<T> Exchange(ScopedPtr<T>&& desired, std::memory_order order = std::memory_order_seq_cst);
+
+		//sets the pointer to desired and bumps the tag if it still holds expected, otherwise loads it into expected
+		bool CompareExchange(TaggedPtr<T>& expected, T* desired, std::memory_order success = std::memory_order_seq_cst, std::memory_order failure = std::memory_order_seq_cst);
+		//same as above, but can fail spuriously, which is cheaper in a loop on some processors
+		bool CompareExchangeWeak(TaggedPtr<T>& expected, T* desired, std::memory_order success = std::memory_order_seq_cst, std::memory_order failure = std::memory_order_seq_cst);
+		//same as above, desired is only released if it was stored
+		bool CompareExchange(TaggedPtr<T>& expected, ScopedPtr<T>& desired, std::memory_order success = std::memory_order_seq_cst, std::memory_order failure = std::memory_order_seq_cst);
+
+		//returns true if the operations never take a lock
+		bool IsLockFree() const;
+
+	private:
+		//the pointer takes the low 48 bits of the word, the tag the high 16
+		static constexpr uint64_t PointerMask = (uint64_t(1) << 48) - 1;
+
+		static uint64_t Pack(T* ptr, uint64_t tag);
+		static TaggedPtr<T> Unpack(uint64_t word);
+
+	private:
+		std::atomic<uint64_t> word;
+	};
+
+	template <typename T>
+	TaggedAtomicPtr<T>::TaggedAtomicPtr()
+		: word(0)
+	{
+	}
+
+	template <typename T>
+	TaggedAtomicPtr<T>::TaggedAtomicPtr(T* ptr)
+		: word(Pack(ptr, 0))
+	{
+	}
+
+	template <typename T>
+	TaggedPtr<T> TaggedAtomicPtr<T>::Load(std::memory_order order) const
+	{
+		return Unpack(word.load(order));
+	}
+
+	template <typename T>
+	void TaggedAtomicPtr<T>::Store(T* ptr, std::memory_order order)
+	{
+		Exchange(ptr, order);
+	}
+
+	template <typename T>
+	TaggedPtr<T> TaggedAtomicPtr<T>::Exchange(T* ptr, std::memory_order order)
+	{
+		//a plain exchange can not bump a tag it has not read, so swap in a loop
+		uint64_t current = word.load(std::memory_order_relaxed);
+		while (!word.compare_exchange_weak(current, Pack(ptr, (current >> 48) + 1), order, std::memory_order_relaxed))
+		{
+		}
+
+		return Unpack(current);
+	}
+
+	template <typename T>
+	ScopedPtr<T> TaggedAtomicPtr<T>::Exchange(ScopedPtr<T>&& desired, std::memory_order order)
+	{
+		TaggedPtr<T> previous = Exchange(desired.Get(), order);
+		desired.Release();
+		return ScopedPtr<T>(previous.ptr);
+	}
+
+	template <typename T>
+	bool TaggedAtomicPtr<T>::CompareExchange(TaggedPtr<T>& expected, T* desired, std::memory_order success, std::memory_order failure)
+	{
+		uint64_t current = Pack(expected.ptr, expected.tag);
+		if (word.compare_exchange_strong(current, Pack(desired, uint64_t(expected.tag) + 1), success, failure))
+			return true;
+
+		expected = Unpack(current);
+		return false;
+	}
+
+	template <typename T>
+	bool TaggedAtomicPtr<T>::CompareExchangeWeak(TaggedPtr<T>& expected, T* desired, std::memory_order success, std::memory_order failure)
+	{
+		uint64_t current = Pack(expected.ptr, expected.tag);
+		if (word.compare_exchange_weak(current, Pack(desired, uint64_t(expected.tag) + 1), success, failure))
+			return true;
+
+		expected = Unpack(current);
+		return false;
+	}
+
+	template <typename T>
+	bool TaggedAtomicPtr<T>::CompareExchange(TaggedPtr<T>& expected, ScopedPtr<T>& desired, std::memory_order success, std::memory_order failure)
+	{
+		if (!CompareExchange(expected, desired.Get(), success, failure))
+			return false;
+
+		//the structure owns it now
+		desired.Release();
+		return true;
+	}
+
+	template <typename T>
+	bool TaggedAtomicPtr<T>::IsLockFree() const
+	{
+		return word.is_lock_free();
+	}
+
+	template <typename T>
+	uint64_t TaggedAtomicPtr<T>::Pack(T* ptr, uint64_t tag)
+	{
+		//a pointer past 48 bits would run into the tag, it is masked so the tag stays intact
+		uint64_t address = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr));
+		assert((address & ~PointerMask) == 0 && "pointer does not fit in 48 bits");
+
+		//the tag wraps around, anything past 16 bits is shifted out
+		return (address & PointerMask) | (tag << 48);
+	}
+
+	template <typename T>
+	TaggedPtr<T> TaggedAtomicPtr<T>::Unpack(uint64_t word)
+	{
+		return TaggedPtr<T>{ reinterpret_cast<T*>(static_cast<uintptr_t>(word & PointerMask)), static_cast<uint16_t>(word >> 48) };
+	}
+}
+
+#endif
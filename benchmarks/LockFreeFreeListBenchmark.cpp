@@ -0,0 +1,188 @@
+/**
+* LockFreeFreeListBenchmark
+* Compares LockFreeFreeList against a std::vector behind a std::mutex, the shared list SlabAllocator used before.
+*
+* Every thread runs the same loop: pop one block, touch it and push it back, then pop a batch of up to 8 blocks
+* and push the whole batch back. The time is taken between releasing every thread at once and joining them,
+* each thread count is run a few times and the fastest run is reported.
+*
+* Not part of any build, compile it on its own from the repository root
+* g++ -std=c++17 -O2 -I. benchmarks/LockFreeFreeListBenchmark.cpp -o freelist_benchmark -pthread
+* ./freelist_benchmark [iterations per thread] [thread counts...]
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LockFreeFreeList.h"
+
+namespace
+{
+	struct Node
+	{
+		Node* next;
+		size_t payload;
+	};
+
+	constexpr size_t BatchSize = 8;
+	constexpr int Runs = 3;
+
+	//the list this replaced in SlabAllocator
+	class MutexList
+	{
+	public:
+		void Push(Node* node)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			nodes.push_back(node);
+		}
+
+		Node* Pop()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (nodes.empty())
+				return nullptr;
+
+			Node* node = nodes.back();
+			nodes.pop_back();
+			return node;
+		}
+
+		size_t PopBatch(Node** batch, size_t max)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			size_t count = 0;
+			while (count < max && !nodes.empty())
+			{
+				batch[count++] = nodes.back();
+				nodes.pop_back();
+			}
+			return count;
+		}
+
+		void PushBatch(Node** batch, size_t count)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			nodes.insert(nodes.end(), batch, batch + count);
+		}
+
+	private:
+		std::vector<Node*> nodes;
+		std::mutex lock;
+	};
+
+	void Work(MutexList& list, size_t iterations)
+	{
+		Node* batch[BatchSize];
+		for (size_t i = 0; i < iterations; i++)
+		{
+			if (Node* node = list.Pop())
+			{
+				node->payload++;
+				list.Push(node);
+			}
+
+			size_t count = list.PopBatch(batch, BatchSize);
+			if (count > 0)
+				list.PushBatch(batch, count);
+		}
+	}
+
+	void Work(Ptr::LockFreeFreeList<Node>& list, size_t iterations)
+	{
+		for (size_t i = 0; i < iterations; i++)
+		{
+			if (Node* node = list.Pop())
+			{
+				node->payload++;
+				list.Push(node);
+			}
+
+			size_t count = 0;
+			Node* first = list.PopBatch(BatchSize, count);
+			if (first != nullptr)
+			{
+				Node* last = first;
+				while (last->next != nullptr)
+					last = last->next;
+
+				list.PushBatch(first, last);
+			}
+		}
+	}
+
+	//returns the time in milliseconds it took threads threads to run iterations loops each
+	template <typename List>
+	double Measure(List& list, int threads, size_t iterations)
+	{
+		std::atomic<bool> start(false);
+		std::vector<std::thread> workers;
+		for (int i = 0; i < threads; i++)
+		{
+			workers.emplace_back([&]()
+			{
+				while (!start.load(std::memory_order_acquire))
+					std::this_thread::yield();
+
+				Work(list, iterations);
+			});
+		}
+
+		auto begin = std::chrono::steady_clock::now();
+		start.store(true, std::memory_order_release);
+		for (std::thread& worker : workers)
+			worker.join();
+		auto end = std::chrono::steady_clock::now();
+
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	}
+
+	template <typename List>
+	double Best(std::vector<Node>& nodes, int threads, size_t iterations)
+	{
+		double best = 0.0;
+		for (int run = 0; run < Runs; run++)
+		{
+			List list;
+			for (Node& node : nodes)
+				list.Push(&node);
+
+			double time = Measure(list, threads, iterations);
+			if (run == 0 || time < best)
+				best = time;
+		}
+		return best;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+
+	std::vector<int> threadCounts;
+	for (int i = 2; i < argc; i++)
+		threadCounts.push_back(std::atoi(argv[i]));
+	if (threadCounts.empty())
+		threadCounts = { 1, 2, 4, 8, 16, 32, 64 };
+
+	std::printf("hardware threads %u, %zu iterations per thread, best of %d runs\n", std::thread::hardware_concurrency(), iterations, Runs);
+	std::printf("%8s %14s %14s %10s\n", "threads", "lock free ms", "mutex ms", "speedup");
+
+	for (int threads : threadCounts)
+	{
+		//enough blocks that every thread can hold a full batch at once
+		std::vector<Node> nodes(size_t(threads) * BatchSize * 2);
+
+		double lockFree = Best<Ptr::LockFreeFreeList<Node>>(nodes, threads, iterations);
+		double mutex = Best<MutexList>(nodes, threads, iterations);
+
+		std::printf("%8d %14.1f %14.1f %9.2fx\n", threads, lockFree, mutex, mutex / lockFree);
+	}
+
+	return 0;
+}